@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+// a minimal timing harness
+// every case is repeated until it ran at least MIN_SECONDS,
+// the fastest and the median repetition are reported
+// the results can be written as json or csv to compare runs over time
+class Benchmark {
+    static constexpr double MIN_SECONDS = 0.5;
+    static constexpr int MIN_REPETITIONS = 3;
+
+    struct Result {
+        std::string name;
+        double seconds;
+        double median_seconds;
+        size_t repetitions;
+        size_t bytes;
+    };
+    std::vector<Result> results;
+
+    // the times of the repetitions of the current case
+    std::vector<double> times;
+
+public:
+    // bytes is the amount of input processed by one call of f,
+    // 0 when the case is not about throughput
+    template <typename Function>
+    void run(const std::string& name, size_t bytes, Function&& f) {
+        run(name, bytes, [] {}, f);
+    }
+
+    // setup runs before every call of f and is not timed,
+    // it puts back what the last call changed
+    template <typename Setup, typename Function>
+    void run(const std::string& name, size_t bytes, Setup&& setup, Function&& f) {
+        using clock = std::chrono::steady_clock;
+        times.clear();
+        auto start = clock::now();
+        while (times.size() < MIN_REPETITIONS ||
+            std::chrono::duration<double>(clock::now() - start).count() < MIN_SECONDS) {
+            setup();
+            auto t0 = clock::now();
+            f();
+            times.push_back(std::chrono::duration<double>(clock::now() - t0).count());
+        }
+
+        std::sort(times.begin(), times.end());
+        Result result{ name, times.front(), times[times.size() / 2], times.size(), bytes };
+        results.push_back(result);
+        if (bytes != 0)
+            std::printf(
+                "%-40s %10.3f ms %8.3f GB/s\n",
+                name.c_str(), result.seconds * 1e3, bytes / result.seconds / 1e9
+            );
+        else
+            std::printf(
+                "%-40s %10.3f us %8.3f us median\n",
+                name.c_str(), result.seconds * 1e6, result.median_seconds * 1e6
+            );
+    }
+
+    // the names are plain ascii, nothing needs to be escaped
+    bool write_json(const char* path) const {
+        auto file = std::fopen(path, "w");
+        if (!file)
+            return false;
+        std::fprintf(file, "[\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            auto& result = results[i];
+            std::fprintf(
+                file,
+                "  {\"name\": \"%s\", \"seconds\": %.9g, \"median_seconds\": %.9g, "
+                "\"repetitions\": %zu, \"bytes\": %zu}%s\n",
+                result.name.c_str(), result.seconds, result.median_seconds,
+                result.repetitions, result.bytes,
+                i + 1 < results.size() ? "," : ""
+            );
+        }
+        std::fprintf(file, "]\n");
+        return std::fclose(file) == 0;
+    }
+
+    bool write_csv(const char* path) const {
+        auto file = std::fopen(path, "w");
+        if (!file)
+            return false;
+        std::fprintf(file, "name,seconds,median_seconds,repetitions,bytes\n");
+        for (auto& result : results)
+            std::fprintf(
+                file, "%s,%.9g,%.9g,%zu,%zu\n",
+                result.name.c_str(), result.seconds, result.median_seconds,
+                result.repetitions, result.bytes
+            );
+        return std::fclose(file) == 0;
+    }
+};
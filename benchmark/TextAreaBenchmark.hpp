@@ -0,0 +1,187 @@
+﻿#pragma once
+
+#include "Benchmark.hpp"
+#include "TextArea.hpp"
+
+#include <string>
+
+// the text area on documents of a million lines, drawn through the
+// headless backend, so that rendering is timed without a console
+class TextAreaBenchmark {
+    static constexpr size_t LINE_COUNT = 1'000'000;
+    static constexpr SHORT WINDOW_WIDTH = 200;
+    static constexpr SHORT WINDOW_HEIGHT = 60;
+
+    // the chars typed or erased by one call, one key at a time
+    static constexpr int KEY_COUNT = 64;
+    // the lines of the range which is deleted at once
+    static constexpr int RANGE_LINE_COUNT = 1000;
+    static constexpr int MOVE_COUNT = 1000;
+
+    // keeps the results from being optimized away
+    static inline volatile size_t total = 0;
+
+    static std::string make_document(const char* line) {
+        std::string str;
+        for (size_t i = 0; i < LINE_COUNT; ++i) {
+            str += std::to_string(i);
+            str += line;
+        }
+        return str;
+    }
+
+    static void press(TextArea& text_area, WORD vk_code, DWORD state, int count) {
+        for (int i = 0; i < count; ++i)
+            text_area.process_keydown(vk_code, state);
+    }
+
+    static void run_editing(Benchmark& benchmark, TextArea& text_area, const std::string& name) {
+        struct Position {
+            const char* name;
+            size_t line_index;
+        } positions[] = {
+            { "start", 0 },
+            { "middle", text_area.get_line_count() / 2 },
+            { "end", text_area.get_line_count() - 1 },
+        };
+
+        std::wstring range;
+        for (int i = 0; i < RANGE_LINE_COUNT; ++i)
+            range += L"a line which is deleted again\n";
+
+        for (auto& position : positions) {
+            auto line_index = position.line_index;
+
+            // the chars typed by the last call are erased before the next
+            bool has_typed = false;
+            benchmark.run(
+                "insert/" + name + "/" + position.name, 0,
+                [&] {
+                    if (has_typed)
+                        press(text_area, VK_BACK, 0, KEY_COUNT);
+                    text_area.set_cursor_pos(line_index, 0);
+                },
+                [&] {
+                    for (int i = 0; i < KEY_COUNT; ++i)
+                        text_area.process_char(L'x');
+                    has_typed = true;
+                }
+            );
+            press(text_area, VK_BACK, 0, KEY_COUNT);
+
+            benchmark.run(
+                "backspace/" + name + "/" + position.name, 0,
+                [&] {
+                    text_area.set_cursor_pos(line_index, 0);
+                    for (int i = 0; i < KEY_COUNT; ++i)
+                        text_area.process_char(L'x');
+                },
+                [&] { press(text_area, VK_BACK, 0, KEY_COUNT); }
+            );
+
+            // the range is typed and selected upwards, then erased at once
+            benchmark.run(
+                "delete_range/" + name + "/" + position.name, 0,
+                [&] {
+                    text_area.set_cursor_pos(line_index, 0);
+                    text_area.process_text(range.data(), range.size());
+                    press(text_area, VK_UP, SHIFT_PRESSED, RANGE_LINE_COUNT);
+                },
+                [&] { text_area.process_keydown(VK_BACK, 0); }
+            );
+        }
+    }
+
+    static void run_moving(Benchmark& benchmark, TextArea& text_area, const std::string& name) {
+        auto middle = text_area.get_line_count() / 2;
+        struct Move {
+            const char* name;
+            WORD vk_code;
+        } moves[] = {
+            { "down", VK_DOWN },
+            { "up", VK_UP },
+            { "right", VK_RIGHT },
+            { "left", VK_LEFT },
+        };
+        for (auto& move : moves)
+            benchmark.run(
+                "move/" + name + "/" + move.name, 0,
+                [&] { text_area.set_cursor_pos(middle, 4); },
+                [&] { press(text_area, move.vk_code, 0, MOVE_COUNT); }
+            );
+    }
+
+    // every call draws the whole text area and waits until the frame
+    // has been presented
+    static void run_rendering(Benchmark& benchmark, TextArea& text_area, const std::string& name) {
+        auto& io = TerminalIO::get_instance();
+        auto render = [&] {
+            text_area.render();
+            io.render();
+            io.finish();
+        };
+        auto middle = text_area.get_line_count() / 2;
+
+        text_area.set_cursor_pos(middle, 0);
+        benchmark.run("render/" + name + "/plain", 0, render);
+
+        press(text_area, VK_DOWN, SHIFT_PRESSED, text_area.get_height() / 2);
+        benchmark.run("render/" + name + "/selection", 0, render);
+
+        // the view jumps between two places, so all the cells change
+        bool is_far = false;
+        benchmark.run(
+            "render/" + name + "/scroll", 0,
+            [&] {
+                is_far = !is_far;
+                text_area.set_cursor_pos(middle + (is_far ? 10 * WINDOW_HEIGHT : 0), 0);
+            },
+            render
+        );
+    }
+
+public:
+    static void run(Benchmark& benchmark) {
+        struct Corpus {
+            const char* name;
+            std::string text;
+        } corpora[] = {
+            {
+                "ascii",
+                make_document(" if (count > limit) return error; // keep the last value\n")
+            },
+            {
+                "cjk",
+                make_document(u8" 这是一个用于测试编辑速度的中文句子，不含英文。\n")
+            },
+            {
+                "mixed",
+                make_document(u8" auto 结果 = compute(索引, 42); // 中文和 ASCII 混合\n")
+            },
+        };
+
+        // the new size of the window is taken by the next frame
+        auto& io = TerminalIO::get_instance();
+        io.resize(WINDOW_WIDTH, WINDOW_HEIGHT);
+        io.render();
+        io.finish();
+
+        // placed as in the editor, after the line numbers
+        TextArea text_area(9, 1, WINDOW_WIDTH - 9, WINDOW_HEIGHT - 2);
+        for (auto& corpus : corpora) {
+            auto& text = corpus.text;
+            benchmark.run(
+                std::string("set_utf_8_string/") + corpus.name, text.size(),
+                [&] { text_area.set_utf_8_string(text.data(), text.size()); }
+            );
+            benchmark.run(
+                std::string("get_utf_8_string/") + corpus.name, text.size(),
+                [&] { total = text_area.get_utf_8_string().size(); }
+            );
+
+            run_editing(benchmark, text_area, corpus.name);
+            run_moving(benchmark, text_area, corpus.name);
+            run_rendering(benchmark, text_area, corpus.name);
+        }
+    }
+};
@@ -0,0 +1,165 @@
+﻿#pragma once
+
+#include "Benchmark.hpp"
+#include "Utf8.hpp"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Utf8Benchmark {
+    // the decoder which TextArea::set_utf_8_string used before,
+    // one vector per line in a list
+    static std::list<std::vector<wchar_t>> legacy_decode(const std::string& str) {
+        std::list<std::vector<wchar_t>> text;
+
+        int rest_byte_count = 0;
+        wchar_t current_char = 0;
+
+        size_t i = 0, j = 0;
+        while (j < str.size()) {
+            i = j;
+            while (str[j] != '\n' && j < str.size())++j;
+            std::vector<wchar_t> vline;
+            vline.reserve((j - i) / 3);
+            while (i < j) {
+                auto ch = str[i];
+                if (rest_byte_count == 0) {
+                    if ((ch & 0b1000'0000) == 0) {
+                        rest_byte_count = 0;
+                        current_char = ch & 0b0111'1111;
+                    }
+                    else if ((ch & 0b1110'0000) == 0b1100'0000) {
+                        rest_byte_count = 1;
+                        current_char = ch & 0b0001'1111;
+                    }
+                    else if ((ch & 0b1111'0000) == 0b1110'0000) {
+                        rest_byte_count = 2;
+                        current_char = ch & 0b0000'1111;
+                    }
+                    else if ((ch & 0b1111'1000) == 0b1111'0000) {
+                        rest_byte_count = 3;
+                        current_char = ch & 0b0000'0111;
+                    }
+                }
+                else {
+                    current_char <<= 6;
+                    current_char |= (ch & 0b0011'1111);
+                    --rest_byte_count;
+                }
+
+                if (rest_byte_count == 0)
+                    vline.push_back(current_char);
+
+                ++i;
+            }
+            text.insert(text.end(), std::move(vline));
+            ++j;
+        }
+        return text;
+    }
+
+    // what set_utf_8_string does now: count, then decode into one buffer
+    static std::unique_ptr<wchar_t[]> decode(const std::string& str) {
+        auto char_count = Utf8::decode(str.data(), str.size(), nullptr);
+        std::unique_ptr<wchar_t[]> chars(new wchar_t[char_count]);
+        Utf8::decode(str.data(), str.size(), chars.get());
+        return chars;
+    }
+
+    // the encoder which TextArea::get_utf_8_string used before
+    static std::string legacy_encode(const std::list<std::vector<wchar_t>>& text) {
+        std::string str;
+        for (auto it = text.begin(); it != text.end(); ) {
+            std::string line;
+            line.reserve(it->size());
+            for (auto ch : *it) {
+                if (ch < 0x007f)
+                    line.push_back(ch);
+                else if (ch < 0x07ff) {
+                    line.push_back(0b11000000 | ((ch >> 6) & 0b00011111));
+                    line.push_back(0b10000000 | (ch & 0b00111111));
+                }
+                else if (ch < 0xffff) {
+                    line.push_back(0b11100000 | ((ch >> 12) & 0b00001111));
+                    line.push_back(0b10000000 | ((ch >> 6) & 0b00111111));
+                    line.push_back(0b10000000 | (ch & 0b00111111));
+                }
+            }
+            str += line;
+            if (++it != text.end())
+                str += '\n';
+        }
+        return str;
+    }
+
+    // stream into a sink which only counts the bytes
+    static size_t encode(const wchar_t* chars, size_t count) {
+        size_t bytes = 0;
+        auto sink = [&bytes](const char*, size_t size) {
+            bytes += size;
+        };
+        Utf8Writer<decltype(sink)> writer(sink);
+        writer.write(chars, count);
+        writer.flush();
+        return bytes;
+    }
+
+public:
+    static std::string make_corpus(const char* line, size_t size) {
+        std::string str;
+        str.reserve(size + 256);
+        for (size_t i = 0; str.size() < size; ++i) {
+            str += std::to_string(i);
+            str += line;
+        }
+        return str;
+    }
+
+    static void run(Benchmark& benchmark) {
+        struct Corpus {
+            const char* name;
+            std::string text;
+        } corpora[] = {
+            {
+                "ascii",
+                make_corpus(
+                    " 2023-05-14T08:31:07Z INFO  request handled path=/api/v1/items status=200 took=12ms\n",
+                    64 << 20
+                )
+            },
+            {
+                "cjk",
+                make_corpus(
+                    u8" 这是一个用于测试解码速度的中文句子，其中夹杂少量的ASCII字符。\n",
+                    64 << 20
+                )
+            },
+        };
+
+        for (auto& corpus : corpora) {
+            auto& text = corpus.text;
+            benchmark.run(
+                std::string("decode/") + corpus.name + "/legacy", text.size(),
+                [&text] { legacy_decode(text); }
+            );
+            benchmark.run(
+                std::string("decode/") + corpus.name + "/utf8", text.size(),
+                [&text] { decode(text); }
+            );
+
+            auto lines = legacy_decode(text);
+            auto char_count = Utf8::decode(text.data(), text.size(), nullptr);
+            auto chars = decode(text);
+            benchmark.run(
+                std::string("encode/") + corpus.name + "/legacy", text.size(),
+                [&lines] { legacy_encode(lines); }
+            );
+            benchmark.run(
+                std::string("encode/") + corpus.name + "/utf8", text.size(),
+                [&chars, char_count] { encode(chars.get(), char_count); }
+            );
+        }
+    }
+};
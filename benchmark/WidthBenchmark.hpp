@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include "Benchmark.hpp"
+#include "Utf8Benchmark.hpp"
+#include "UnicodeWidth.hpp"
+
+#include <memory>
+#include <string>
+
+class WidthBenchmark {
+    // the range comparisons which OutputWriter::get_font_width did before
+    static int legacy_width(wchar_t ch) {
+        if ((0x2e80 <= ch && ch <= 0x9fff) ||
+            (0xac00 <= ch && ch <= 0xd7ff) ||
+            (0xf900 <= ch && ch <= 0xfaff) ||
+            (0xfe10 <= ch && ch <= 0xfe1f) ||
+            (0xfe30 <= ch && ch <= 0xfe6f) ||
+            (0xff00 <= ch && ch <= 0xff60) ||
+            (0x1f300 <= ch && ch <= 0x1faff) ||
+            (0x20000 <= ch && ch <= 0x2fa1f))
+            return 2;
+        return 1;
+    }
+
+    // keeps the results from being optimized away
+    static inline volatile size_t total = 0;
+
+public:
+    static void run(Benchmark& benchmark) {
+        struct Corpus {
+            const char* name;
+            std::string text;
+        } corpora[] = {
+            {
+                "ascii",
+                Utf8Benchmark::make_corpus(
+                    " 2023-05-14T08:31:07Z INFO  request handled path=/api/v1/items status=200 took=12ms\n",
+                    16 << 20
+                )
+            },
+            {
+                "cjk",
+                Utf8Benchmark::make_corpus(
+                    u8" 这是一个用于测试解码速度的中文句子，其中夹杂少量的ASCII字符。\n",
+                    16 << 20
+                )
+            },
+        };
+
+        for (auto& corpus : corpora) {
+            auto count = Utf8::decode(corpus.text.data(), corpus.text.size(), nullptr);
+            std::unique_ptr<wchar_t[]> chars(new wchar_t[count]);
+            Utf8::decode(corpus.text.data(), corpus.text.size(), chars.get());
+            auto data = chars.get();
+            auto bytes = count * sizeof(wchar_t);
+
+            benchmark.run(
+                std::string("width/") + corpus.name + "/legacy", bytes,
+                [data, count] {
+                    size_t width = 0;
+                    for (size_t i = 0; i < count; ++i)
+                        width += legacy_width(data[i]);
+                    total = width;
+                }
+            );
+            benchmark.run(
+                std::string("width/") + corpus.name + "/table", bytes,
+                [data, count] {
+                    size_t width = 0;
+                    for (size_t i = 0; i < count; ++i)
+                        width += UnicodeWidth::get(char32_t(data[i]));
+                    total = width;
+                }
+            );
+            benchmark.run(
+                std::string("width/") + corpus.name + "/span", bytes,
+                [data, count] { total = UnicodeWidth::get(data, count); }
+            );
+        }
+    }
+};
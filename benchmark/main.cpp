@@ -0,0 +1,36 @@
+#include "Utf8Benchmark.hpp"
+#include "WidthBenchmark.hpp"
+#include "TextAreaBenchmark.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+// benchmark [--json path] [--csv path]
+int main(int argc, char* argv[]) {
+    const char* json_path = nullptr;
+    const char* csv_path = nullptr;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 < argc && std::strcmp(argv[i], "--json") == 0)
+            json_path = argv[i + 1];
+        else if (i + 1 < argc && std::strcmp(argv[i], "--csv") == 0)
+            csv_path = argv[i + 1];
+        else {
+            std::fprintf(stderr, "usage: %s [--json path] [--csv path]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Benchmark benchmark;
+    Utf8Benchmark::run(benchmark);
+    WidthBenchmark::run(benchmark);
+    TextAreaBenchmark::run(benchmark);
+
+    if (json_path && !benchmark.write_json(json_path)) {
+        std::fprintf(stderr, "cannot write %s\n", json_path);
+        return 1;
+    }
+    if (csv_path && !benchmark.write_csv(csv_path)) {
+        std::fprintf(stderr, "cannot write %s\n", csv_path);
+        return 1;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Document.hpp"
+#include "Terminal.hpp"
+
+#include <string>
+#include <memory>
+
+// the register which copying fills and pasting reads
+// it holds the copied range as a snapshot, so a copy costs the pieces
+// of the range whatever its length, and a paste splices them back
+// the system clipboard is written only when another program may read
+// it, when the editor loses the focus or quits, and pasting takes the
+// system clipboard instead when it was changed after the copy
+class Clipboard {
+    TerminalIO& io = TerminalIO::get_instance();
+
+    Document::Snapshot text;
+
+    // the register is newer than the system clipboard
+    bool is_unpublished = false;
+
+    // matches no version, so the first paste reads the system clipboard,
+    // which may hold what was copied before the editor started
+    static constexpr size_t NO_VERSION = size_t(-1);
+
+    // the version of the system clipboard which the register replaces
+    size_t system_version = NO_VERSION;
+
+    Clipboard() = default;
+
+public:
+    static Clipboard& get_instance() {
+        static Clipboard instance;
+        return instance;
+    }
+
+    void copy(Document::Snapshot snapshot) {
+        text = std::move(snapshot);
+        is_unpublished = true;
+        system_version = io.get_clipboard_version();
+    }
+
+    const Document::Snapshot& paste() {
+        auto version = io.get_clipboard_version();
+        if (version != system_version) {
+            std::wstring system_text;
+            if (io.read_clipboard(system_text))
+                text = Document::Snapshot(to_chunk(system_text));
+            is_unpublished = false;
+            system_version = version;
+        }
+        return text;
+    }
+
+    // give the register to the system clipboard
+    void publish() {
+        if (!is_unpublished)
+            return;
+        std::wstring wstr;
+        wstr.reserve(text.size());
+        text.for_each_span(
+            [&wstr](const Document::Char* chars, size_t count) {
+                wstr.append(chars, count);
+                return true;
+            }
+        );
+        io.write_clipboard(wstr);
+        is_unpublished = false;
+        system_version = io.get_clipboard_version();
+    }
+
+private:
+    // the line breaks of the other programs become '\n'
+    static Document::Chunk to_chunk(const std::wstring& wstr) {
+        auto chars = std::make_unique<Document::Char[]>(wstr.size());
+        size_t size = 0;
+        for (size_t i = 0; i < wstr.size(); ++i) {
+            if (wstr[i] == '\r') {
+                if (i + 1 < wstr.size() && wstr[i + 1] == '\n')
+                    ++i;
+                chars[size++] = '\n';
+            }
+            else
+                chars[size++] = wstr[i];
+        }
+        return Document::Chunk(std::move(chars), size);
+    }
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Document.hpp"
+#include "UnicodeWidth.hpp"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// maps between char indices and display columns of lines
+// for each line in use the columns at every STRIDE chars are cached,
+// so a lookup measures at most STRIDE chars, and none at all inside
+// a stride of printable ascii
+// the strides are measured lazily from the start of the line, and an
+// edit drops only the strides from the changed char on
+class ColumnIndex {
+    static constexpr size_t STRIDE = 64;
+
+    // lines beyond this many are forgotten at once
+    static constexpr size_t MAX_LINES = 256;
+
+    struct Line {
+        size_t length = 0;
+
+        // columns[k] is the width of the first k * STRIDE chars
+        std::vector<size_t> columns{ 0 };
+        // is_ascii[k] when the chars of stride k are all printable ascii,
+        // one column each, a stride as wide as its chars may still mix
+        // wide chars with zero-width ones
+        std::vector<bool> is_ascii;
+    };
+
+    const Document& text;
+    std::unordered_map<size_t, Line> lines;
+
+public:
+    ColumnIndex(const Document& text) :
+        text(text) {}
+
+    ColumnIndex(const ColumnIndex&) = delete;
+    ColumnIndex& operator=(const ColumnIndex&) = delete;
+
+    // the display width of the chars [0, char_index) of the line
+    size_t column_of(size_t line_index, size_t char_index) {
+        auto& line = get_line(line_index);
+        char_index = std::min(char_index, line.length);
+        auto k = char_index / STRIDE;
+        auto rest = char_index - k * STRIDE;
+        measure(line_index, line, std::min(k + 1, line.length / STRIDE));
+        if (rest == 0)
+            return line.columns[k];
+        if (k < line.is_ascii.size() && line.is_ascii[k])
+            return line.columns[k] + rest;
+        return line.columns[k] + width_of(text.line_start(line_index) + k * STRIDE, rest);
+    }
+
+    // the first char of the line which starts at or after the column,
+    // or the length of the line if it is narrower
+    size_t char_at(size_t line_index, size_t column) {
+        auto& line = get_line(line_index);
+        // only whole strides are cached, the rest of the line is measured below
+        while (line.columns.back() < column && line.columns.size() * STRIDE <= line.length)
+            measure(line_index, line, line.columns.size());
+
+        // the last stride which starts before the column
+        auto it = std::lower_bound(line.columns.begin(), line.columns.end(), column);
+        if (it == line.columns.begin())
+            return 0;
+        auto k = size_t(it - line.columns.begin()) - 1;
+
+        auto width = line.columns[k];
+        auto char_index = k * STRIDE;
+        text.for_each_span(
+            text.line_start(line_index) + char_index,
+            std::min(STRIDE, line.length - char_index),
+            [&](const Document::Char* chars, size_t count) {
+                for (size_t i = 0; i < count && width < column; ++i, ++char_index)
+                    width += UnicodeWidth::get(char32_t(chars[i]));
+                return width < column;
+            }
+        );
+        return char_index;
+    }
+
+    // the chars of the line from char_index on have changed,
+    // while the other lines are the same
+    void invalidate(size_t line_index, size_t char_index) {
+        auto it = lines.find(line_index);
+        if (it == lines.end())
+            return;
+        auto& line = it->second;
+        line.length = text.line_length(line_index);
+        line.columns.resize(std::min(line.columns.size(), char_index / STRIDE + 1));
+        line.is_ascii.resize(line.columns.size() - 1);
+    }
+
+    // lines were added or removed
+    void clear() {
+        lines.clear();
+    }
+
+private:
+    Line& get_line(size_t line_index) {
+        auto it = lines.find(line_index);
+        if (it != lines.end())
+            return it->second;
+        if (lines.size() >= MAX_LINES)
+            lines.clear();
+        auto& line = lines[line_index];
+        line.length = text.line_length(line_index);
+        return line;
+    }
+
+    // make sure that columns[k] is known
+    void measure(size_t line_index, Line& line, size_t k) {
+        if (k < line.columns.size())
+            return;
+        auto line_start = text.line_start(line_index);
+        while (line.columns.size() <= k) {
+            auto first = (line.columns.size() - 1) * STRIDE;
+            bool is_ascii = true;
+            line.columns.push_back(
+                line.columns.back() +
+                width_of(line_start + first, std::min(STRIDE, line.length - first), &is_ascii)
+            );
+            line.is_ascii.push_back(is_ascii);
+        }
+    }
+
+    size_t width_of(size_t pos, size_t count, bool* is_ascii = nullptr) {
+        size_t width = 0;
+        text.for_each_span(
+            pos, count,
+            [&width, is_ascii](const Document::Char* chars, size_t n) {
+                width += UnicodeWidth::get(chars, n);
+                if (is_ascii && *is_ascii)
+                    *is_ascii = std::all_of(chars, chars + n,
+                        [](Document::Char ch) { return ch >= 0x20 && ch < 0x7f; });
+                return true;
+            }
+        );
+        return width;
+    }
+};
@@ -2,15 +2,24 @@
 
 #include "Terminal.hpp"
 
+// a component renders again only after it has been invalidated,
+// otherwise draw() replays the commands of its last render
 class Component {
     SHORT left;
     SHORT top;
     SHORT width;
     SHORT height;
 
+    TerminalIO::Recording recording;
+    bool is_invalid = true;
+
 protected:
     inline static TerminalIO& io = TerminalIO::get_instance();
 
+    // called before drawing, a component which changes with the time
+    // invalidates itself here
+    virtual void update() {}
+
 public:
     Component(
         SHORT left, SHORT top,
@@ -29,6 +38,24 @@ public:
 
     virtual void render() = 0;
 
+    // render inside the clip of the component, above the lower layers
+    void draw(int layer = 0) {
+        update();
+        io.push_clip(left, top, width, height, layer);
+        if (is_invalid || !io.replay(recording)) {
+            auto mark = io.begin_recording();
+            render();
+            io.end_recording(mark, recording);
+            is_invalid = false;
+        }
+        io.pop_clip();
+    }
+
+    // the next draw() renders again
+    void invalidate() {
+        is_invalid = true;
+    }
+
     SHORT get_width() {
         return width;
     }
@@ -43,15 +70,23 @@ public:
     }
 
     void set_width(SHORT width) {
+        if (this->width != width)
+            invalidate();
         this->width = width;
     }
     void set_height(SHORT height) {
+        if (this->height != height)
+            invalidate();
         this->height = height;
     }
     void set_left(SHORT left) {
+        if (this->left != left)
+            invalidate();
         this->left = left;
     }
     void set_top(SHORT top) {
+        if (this->top != top)
+            invalidate();
         this->top = top;
     }
 };
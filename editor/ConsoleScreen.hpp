@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "FrameBuffer.hpp"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// the windows console
+// cells are converted to CHAR_INFO and written with WriteConsoleOutput
+// the console gives a wide char two columns of its own, which moves the
+// rest of the row, so a row with wide chars is written as a whole
+// without its continuation cells, and padded at the end
+class ConsoleScreen {
+    HANDLE hstdout;
+
+    // the rows which hold wide chars on the console
+    std::vector<bool> packed_rows;
+    std::vector<CHAR_INFO> cells;
+    // the row which has been written as a whole in this frame
+    SHORT packed_y = -1;
+
+public:
+    ConsoleScreen() :
+        hstdout(GetStdHandle(STD_OUTPUT_HANDLE)) {
+        // hide the cursor
+        CONSOLE_CURSOR_INFO cursor_info;
+        GetConsoleCursorInfo(hstdout, &cursor_info);
+        cursor_info.bVisible = false;
+        SetConsoleCursorInfo(hstdout, &cursor_info);
+    }
+
+    ConsoleScreen(const ConsoleScreen&) = delete;
+    ConsoleScreen& operator=(const ConsoleScreen&) = delete;
+
+    COORD get_size() {
+        CONSOLE_SCREEN_BUFFER_INFO csbi_info;
+        GetConsoleScreenBufferInfo(hstdout, &csbi_info);
+        return {
+            SHORT(csbi_info.srWindow.Right - csbi_info.srWindow.Left + 1),
+            SHORT(csbi_info.srWindow.Bottom - csbi_info.srWindow.Top + 1)
+        };
+    }
+
+    // drop the scrollback, the screen buffer is as large as the window
+    void set_size(COORD size) {
+        SetConsoleScreenBufferSize(hstdout, size);
+        packed_rows.assign(size.Y, false);
+    }
+
+    // write the cells [first, last) of the row y
+    void write(const FrameBuffer& frame, SHORT first, SHORT last, SHORT y) {
+        auto chars = frame.get_chars(y);
+        auto attributes = frame.get_attributes(y);
+        auto width = frame.get_width();
+        bool has_wide_chars = std::find(chars, chars + width, CONTINUATION_CHAR) != chars + width;
+        if (has_wide_chars || packed_rows[y]) {
+            if (y != packed_y)
+                write_packed(chars, attributes, width, y);
+            packed_rows[y] = has_wide_chars;
+            return;
+        }
+
+        cells.resize(last - first);
+        for (auto x = first; x < last; ++x) {
+            cells[x - first].Char.UnicodeChar = chars[x];
+            cells[x - first].Attributes = attributes[x];
+        }
+        write_cells(first, y);
+    }
+
+    // the console is not driven by escape sequences, they are dropped
+    void write_sequence(const std::string&) {}
+
+    void end_frame() {
+        packed_y = -1;
+    }
+
+private:
+    void write_packed(const wchar_t* chars, const WORD* attributes, SHORT width, SHORT y) {
+        cells.clear();
+        for (SHORT x = 0; x < width; ++x)
+            if (chars[x] != CONTINUATION_CHAR) {
+                CHAR_INFO cell;
+                cell.Char.UnicodeChar = chars[x];
+                cell.Attributes = attributes[x];
+                cells.push_back(cell);
+            }
+        // the columns which the wide chars took are left at the end
+        CHAR_INFO padding{};
+        padding.Attributes = attributes[width - 1];
+        cells.resize(width, padding);
+        write_cells(0, y);
+        packed_y = y;
+    }
+
+    // write the converted cells to the row y from the column x
+    void write_cells(SHORT x, SHORT y) {
+        SMALL_RECT rect{ x, y, SHORT(x + cells.size() - 1), y };
+        WriteConsoleOutput(
+            hstdout,
+            cells.data(),
+            { SHORT(cells.size()), 1 },
+            { 0, 0 },
+            &rect
+        );
+    }
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Component.hpp"
-#include <ctime>
+#include <chrono>
 
 class Cursor :
     public Component {
@@ -16,17 +16,22 @@ public:
     ) :
         Component(left, top, 1, 1) {}
 
+public:
+    using Clock = std::chrono::steady_clock;
+
 private:
-    clock_t last_show_t = clock();
-    static constexpr clock_t PERIOD = 500;
+    static constexpr auto PERIOD = std::chrono::milliseconds(500);
+
+    // when the cursor blinks next
+    Clock::time_point next_blink = Clock::now() + PERIOD;
 
     bool on = false;
 
 public:
     void render() {
-        auto t = clock();
-        if (t - last_show_t > PERIOD) {
-            last_show_t = t;
+        auto now = Clock::now();
+        if (now >= next_blink) {
+            next_blink = now + PERIOD;
             on = !on;
         }
         TerminalIO::get_instance().set_font_style(
@@ -36,10 +41,13 @@ public:
         );
     }
 
+    // the cursor must be rendered again by then
+    Clock::time_point get_deadline() {
+        return next_blink;
+    }
+
     void should_be_on() {
-        if (!on) {
-            last_show_t += PERIOD;
-            on = true;
-        }
+        next_blink = Clock::now() + PERIOD;
+        on = true;
     }
 };
\ No newline at end of file
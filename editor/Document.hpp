@@ -0,0 +1,702 @@
+#pragma once
+
+#include "Simd.hpp"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+
+// piece table
+// the text is described by a sequence of pieces, each one refers to
+// a range of an immutable buffer: the original buffer holds the loaded
+// text, the add buffers only grow at their ends while editing
+// pieces are kept in a treap, so edits cost O(log pieces)
+// every node also sums the line feeds in its subtree, so mapping between
+// lines and offsets is a single descent of the tree
+// edits are local in practice: typing extends the piece which was added
+// last and deleting at either end of a piece trims it, both in place
+// the chars which a piece refers to never change, so a snapshot is just
+// a copy of the pieces which keeps the buffers alive
+class Document {
+public:
+    using Char = wchar_t;
+
+    class Snapshot;
+    class Chunk;
+    class Slice;
+
+private:
+    struct Buffer {
+        std::unique_ptr<Char[]> data;
+        size_t size = 0;
+        size_t capacity = 0;
+
+        // offsets of all the '\n' in the buffer, in ascending order
+        std::vector<size_t> line_breaks;
+
+        Buffer(size_t capacity) :
+            data(new Char[capacity]), capacity(capacity) {}
+
+        Buffer(std::unique_ptr<Char[]> data, size_t size) :
+            data(std::move(data)), size(size), capacity(size) {
+            auto first = this->data.get();
+            auto last = first + size;
+            for (auto it = Simd::find(first, last, '\n'); it != last; it = Simd::find(it + 1, last, '\n'))
+                line_breaks.push_back(it - first);
+        }
+
+        void append(const Char* chars, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                if (chars[i] == '\n')
+                    line_breaks.push_back(size + i);
+                data[size + i] = chars[i];
+            }
+            size += count;
+        }
+
+        // the number of '\n' in [first, last)
+        size_t count_line_breaks(size_t first, size_t last) const {
+            return
+                std::lower_bound(line_breaks.begin(), line_breaks.end(), last) -
+                std::lower_bound(line_breaks.begin(), line_breaks.end(), first);
+        }
+    };
+
+    struct Piece {
+        uint32_t buffer;
+        size_t start;
+        size_t length;
+        size_t line_feeds;
+    };
+
+    using NodeIndex = uint32_t;
+    static constexpr NodeIndex NIL = 0;
+
+    struct Node {
+        Piece piece;
+        NodeIndex left = NIL;
+        NodeIndex right = NIL;
+        uint32_t priority = 0;
+
+        // sums of the piece lengths and line feeds in the subtree
+        size_t length = 0;
+        size_t line_feeds = 0;
+    };
+
+public:
+    // the text at one moment, which can be read from another thread
+    // while the document goes on being edited
+    // it can also be inserted into any document, which then shares
+    // the buffers instead of copying the chars
+    class Snapshot {
+        friend class Document;
+
+        std::vector<Piece> pieces;
+        std::vector<std::shared_ptr<const Buffer>> buffers;
+        size_t length = 0;
+
+    public:
+        Snapshot() {}
+
+        // the text of the chunk
+        explicit Snapshot(const Chunk& chunk) :
+            buffers{ chunk.buffer },
+            length(chunk.size()) {
+            if (length > 0)
+                pieces.push_back({ 0, 0, length, chunk.buffer->line_breaks.size() });
+        }
+
+        size_t size() const {
+            return length;
+        }
+
+        // call f(const Char* first, size_t count) on each contiguous span
+        // of the text in order, stop when f returns false
+        template <typename Function>
+        void for_each_span(Function&& f) const {
+            for (auto& piece : pieces)
+                if (!f(buffers[piece.buffer]->data.get() + piece.start, piece.length))
+                    return;
+        }
+    };
+
+    // decoded text which becomes an original buffer of the document,
+    // it can be prepared on another thread
+    class Chunk {
+        friend class Document;
+
+        std::shared_ptr<Buffer> buffer;
+
+    public:
+        Chunk(std::unique_ptr<Char[]> chars, size_t size) :
+            buffer(std::make_shared<Buffer>(std::move(chars), size)) {}
+
+        size_t size() const {
+            return buffer->size;
+        }
+    };
+
+    // a range of the text as pieces, no chars are copied
+    // it refers to the buffers of the document by index,
+    // so it stays valid until the document is cleared
+    class Slice {
+        friend class Document;
+
+        std::vector<Piece> pieces;
+        size_t length = 0;
+
+    public:
+        size_t size() const {
+            return length;
+        }
+
+        // the memory taken by the pieces, not by the chars
+        size_t memory_size() const {
+            return sizeof(Slice) + pieces.capacity() * sizeof(Piece);
+        }
+
+        // add the slice to the end,
+        // pieces which continue each other in a buffer are joined
+        void append(const Slice& slice) {
+            auto first = slice.pieces.begin();
+            if (first != slice.pieces.end() && !pieces.empty() && join(pieces.back(), *first))
+                ++first;
+            pieces.insert(pieces.end(), first, slice.pieces.end());
+            length += slice.length;
+        }
+
+        // add the slice to the beginning
+        void prepend(const Slice& slice) {
+            auto last = slice.pieces.end();
+            if (last != slice.pieces.begin() && !pieces.empty()) {
+                auto joined = *(last - 1);
+                if (join(joined, pieces.front())) {
+                    pieces.front() = joined;
+                    --last;
+                }
+            }
+            pieces.insert(pieces.begin(), slice.pieces.begin(), last);
+            length += slice.length;
+        }
+
+    private:
+        static bool join(Piece& piece, const Piece& next) {
+            if (piece.buffer != next.buffer || piece.start + piece.length != next.start)
+                return false;
+            piece.length += next.length;
+            piece.line_feeds += next.line_feeds;
+            return true;
+        }
+    };
+
+private:
+    // the size of a freshly allocated add buffer
+    static constexpr size_t ADD_BUFFER_CAPACITY = 1 << 16;
+
+    // shared with the snapshots
+    std::vector<std::shared_ptr<Buffer>> buffers;
+    uint32_t add_buffer = 0;
+
+    // nodes[0] is the sentinel
+    std::vector<Node> nodes{ Node() };
+    std::vector<NodeIndex> free_nodes;
+    NodeIndex root = NIL;
+    uint32_t seed = 0x9e3779b9;
+
+    // the nodes from the root to the last node found
+    std::vector<NodeIndex> path;
+
+public:
+    Document() {
+        clear();
+    }
+
+    void clear() {
+        buffers.clear();
+        nodes.resize(1);
+        free_nodes.clear();
+        root = NIL;
+        add_buffer = new_buffer(ADD_BUFFER_CAPACITY);
+    }
+
+    // take over the text as the original buffer
+    void assign(std::unique_ptr<Char[]> chars, size_t size) {
+        clear();
+        if (size == 0)
+            return;
+        buffers.push_back(std::make_shared<Buffer>(std::move(chars), size));
+        auto original = uint32_t(buffers.size() - 1);
+        root = new_node(make_piece(original, 0, size));
+    }
+
+    void assign(Chunk chunk) {
+        clear();
+        append(std::move(chunk));
+    }
+
+    // add the chunk to the end of the text
+    void append(Chunk chunk) {
+        if (chunk.size() == 0)
+            return;
+        buffers.push_back(std::move(chunk.buffer));
+        auto buffer = uint32_t(buffers.size() - 1);
+        root = merge(root, new_node(make_piece(buffer, 0, buffers[buffer]->size)));
+    }
+
+    void assign(const Char* chars, size_t size) {
+        std::unique_ptr<Char[]> data(new Char[size]);
+        std::copy(chars, chars + size, data.get());
+        assign(std::move(data), size);
+    }
+
+public:
+    size_t size() const {
+        return nodes[root].length;
+    }
+
+    size_t line_count() const {
+        return nodes[root].line_feeds + 1;
+    }
+
+    // offset of the first char of the line
+    size_t line_start(size_t line) const {
+        if (line == 0)
+            return 0;
+        if (line > nodes[root].line_feeds)
+            return size();
+
+        // look for the line-th '\n'
+        size_t offset = 0;
+        size_t rest = line;
+        auto index = root;
+        while (true) {
+            auto& node = nodes[index];
+            auto& left = nodes[node.left];
+            if (rest <= left.line_feeds) {
+                index = node.left;
+            }
+            else if (rest <= left.line_feeds + node.piece.line_feeds) {
+                rest -= left.line_feeds;
+                auto& breaks = buffers[node.piece.buffer]->line_breaks;
+                auto first = std::lower_bound(breaks.begin(), breaks.end(), node.piece.start);
+                return offset + left.length + (first[rest - 1] - node.piece.start) + 1;
+            }
+            else {
+                rest -= left.line_feeds + node.piece.line_feeds;
+                offset += left.length + node.piece.length;
+                index = node.right;
+            }
+        }
+    }
+
+    // the number of chars in the line, excluding '\n'
+    size_t line_length(size_t line) const {
+        auto first = line_start(line);
+        auto last = line < nodes[root].line_feeds ? line_start(line + 1) - 1 : size();
+        return last - first;
+    }
+
+    // the line which the char at pos belongs to
+    size_t line_of(size_t pos) const {
+        if (pos >= size())
+            return nodes[root].line_feeds;
+
+        size_t line = 0;
+        auto index = root;
+        while (true) {
+            auto& node = nodes[index];
+            auto& left = nodes[node.left];
+            if (pos < left.length) {
+                index = node.left;
+            }
+            else if (pos < left.length + node.piece.length) {
+                pos -= left.length;
+                return line + left.line_feeds + buffers[node.piece.buffer]->count_line_breaks(
+                    node.piece.start, node.piece.start + pos
+                );
+            }
+            else {
+                pos -= left.length + node.piece.length;
+                line += left.line_feeds + node.piece.line_feeds;
+                index = node.right;
+            }
+        }
+    }
+
+    Char at(size_t pos) const {
+        Char ch = 0;
+        for_each_span(
+            pos, 1,
+            [&ch](const Char* first, size_t) {
+                ch = *first;
+                return false;
+            }
+        );
+        return ch;
+    }
+
+    // call f(const Char* first, size_t count) on each contiguous span
+    // of the text in [pos, pos + count), stop when f returns false
+    template <typename Function>
+    void for_each_span(size_t pos, size_t count, Function&& f) const {
+        if (count == 0)
+            return;
+        auto span = [this, &f](const Piece& piece, size_t first, size_t n) {
+            return f(buffers[piece.buffer]->data.get() + piece.start + first, n);
+        };
+        for_each_piece(root, 0, pos, pos + count, span);
+    }
+
+    template <typename OutputIterator>
+    OutputIterator copy(size_t pos, size_t count, OutputIterator out) const {
+        for_each_span(
+            pos, count,
+            [&out](const Char* first, size_t n) {
+                out = std::copy(first, first + n, out);
+                return true;
+            }
+        );
+        return out;
+    }
+
+    Snapshot snapshot() const {
+        Snapshot snapshot;
+        snapshot.buffers.assign(buffers.begin(), buffers.end());
+        snapshot.length = size();
+        collect_pieces(root, snapshot.pieces);
+        return snapshot;
+    }
+
+    // the range [pos, pos + count) as a snapshot
+    Snapshot snapshot(size_t pos, size_t count) const {
+        Snapshot snapshot;
+        snapshot.buffers.assign(buffers.begin(), buffers.end());
+        snapshot.length = count;
+        snapshot.pieces = slice(pos, count).pieces;
+        return snapshot;
+    }
+
+    Slice slice(size_t pos, size_t count) const {
+        Slice slice;
+        slice.length = count;
+        auto collect = [this, &slice](const Piece& piece, size_t first, size_t n) {
+            slice.pieces.push_back(make_piece(piece.buffer, piece.start + first, n));
+            return true;
+        };
+        if (count > 0)
+            for_each_piece(root, 0, pos, pos + count, collect);
+        return slice;
+    }
+
+    std::wstring get_wstring(size_t pos, size_t count) const {
+        std::wstring wstr;
+        wstr.reserve(count);
+        copy(pos, count, std::back_inserter(wstr));
+        return wstr;
+    }
+
+public:
+    void insert(size_t pos, Char ch) {
+        insert(pos, &ch, 1);
+    }
+
+    void insert(size_t pos, const Char* chars, size_t count) {
+        if (count == 0 || try_extend(pos, chars, count))
+            return;
+
+        NodeIndex left, right;
+        split(root, pos, left, right);
+        while (count > 0) {
+            if (buffers[add_buffer]->size == buffers[add_buffer]->capacity)
+                add_buffer = new_buffer(std::max(count, ADD_BUFFER_CAPACITY));
+            auto& buffer = *buffers[add_buffer];
+            auto n = std::min(count, buffer.capacity - buffer.size);
+            auto start = buffer.size;
+            buffer.append(chars, n);
+            left = merge(left, new_node(make_piece(add_buffer, start, n)));
+            chars += n;
+            count -= n;
+        }
+        root = merge(left, right);
+    }
+
+    // put the pieces of the slice back, no chars are copied
+    void insert(size_t pos, const Slice& slice) {
+        if (slice.size() == 0)
+            return;
+
+        NodeIndex left, right;
+        split(root, pos, left, right);
+        for (auto& piece : slice.pieces)
+            left = merge(left, new_node(piece));
+        root = merge(left, right);
+    }
+
+    // put the pieces of the snapshot, which may be of another document,
+    // no chars are copied
+    void insert(size_t pos, const Snapshot& snapshot) {
+        if (snapshot.size() == 0)
+            return;
+
+        // the indices of the buffers of the snapshot in this document
+        std::vector<uint32_t> indices(snapshot.buffers.size(), UINT32_MAX);
+        Slice slice;
+        slice.length = snapshot.size();
+        slice.pieces.reserve(snapshot.pieces.size());
+        for (auto piece : snapshot.pieces) {
+            auto& index = indices[piece.buffer];
+            if (index == UINT32_MAX)
+                index = share_buffer(snapshot.buffers[piece.buffer]);
+            piece.buffer = index;
+            slice.pieces.push_back(piece);
+        }
+        insert(pos, slice);
+    }
+
+    void erase(size_t pos, size_t count) {
+        if (count == 0 || try_trim(pos, count))
+            return;
+
+        NodeIndex left, middle, right;
+        split(root, pos, left, middle);
+        split(middle, count, middle, right);
+        free_tree(middle);
+        root = merge(left, right);
+    }
+
+private:
+    // the node which contains the char at pos, and the offset of its piece
+    // the nodes on the way are recorded in path
+    NodeIndex find(size_t pos, size_t& piece_offset) {
+        path.clear();
+        piece_offset = 0;
+        auto index = root;
+        while (index != NIL) {
+            path.push_back(index);
+            auto& node = nodes[index];
+            auto left_length = nodes[node.left].length;
+            if (pos < left_length) {
+                index = node.left;
+            }
+            else if (pos < left_length + node.piece.length) {
+                piece_offset += left_length;
+                return index;
+            }
+            else {
+                pos -= left_length + node.piece.length;
+                piece_offset += left_length + node.piece.length;
+                index = node.right;
+            }
+        }
+        return NIL;
+    }
+
+    void update_path() {
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+            update(*it);
+    }
+
+    // append to the piece which ends at pos, if it is the last one
+    // taken from the add buffer and the add buffer has enough room
+    bool try_extend(size_t pos, const Char* chars, size_t count) {
+        auto& buffer = *buffers[add_buffer];
+        if (pos == 0 || count > buffer.capacity - buffer.size)
+            return false;
+
+        size_t piece_offset;
+        auto index = find(pos - 1, piece_offset);
+        if (index == NIL)
+            return false;
+        auto& piece = nodes[index].piece;
+        if (piece.buffer != add_buffer ||
+            piece.start + piece.length != buffer.size ||
+            piece_offset + piece.length != pos)
+            return false;
+
+        buffer.append(chars, count);
+        piece = make_piece(piece.buffer, piece.start, piece.length + count);
+        update_path();
+        return true;
+    }
+
+    // erase the range in place, if it is at the beginning or the end
+    // of a single piece
+    bool try_trim(size_t pos, size_t count) {
+        size_t piece_offset;
+        auto index = find(pos, piece_offset);
+        if (index == NIL)
+            return false;
+        auto& piece = nodes[index].piece;
+        if (count >= piece.length)
+            return false;
+
+        if (pos == piece_offset)
+            piece = make_piece(piece.buffer, piece.start + count, piece.length - count);
+        else if (pos + count == piece_offset + piece.length)
+            piece = make_piece(piece.buffer, piece.start, piece.length - count);
+        else
+            return false;
+        update_path();
+        return true;
+    }
+
+    // the index of a buffer of another document, which is added if needed
+    // the chars of the ranges in use are never written again, and only
+    // the add buffer of this document is appended to
+    uint32_t share_buffer(const std::shared_ptr<const Buffer>& buffer) {
+        for (uint32_t i = 0; i < buffers.size(); ++i)
+            if (buffers[i] == buffer)
+                return i;
+        buffers.push_back(std::const_pointer_cast<Buffer>(buffer));
+        return uint32_t(buffers.size() - 1);
+    }
+
+    uint32_t new_buffer(size_t capacity) {
+        buffers.push_back(std::make_shared<Buffer>(capacity));
+        return uint32_t(buffers.size() - 1);
+    }
+
+    Piece make_piece(uint32_t buffer, size_t start, size_t length) const {
+        return {
+            buffer, start, length,
+            buffers[buffer]->count_line_breaks(start, start + length)
+        };
+    }
+
+    uint32_t next_priority() {
+        // xorshift32
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    NodeIndex new_node(const Piece& piece) {
+        NodeIndex index;
+        if (!free_nodes.empty()) {
+            index = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        else {
+            index = NodeIndex(nodes.size());
+            nodes.emplace_back();
+        }
+        auto& node = nodes[index];
+        node = Node();
+        node.piece = piece;
+        node.priority = next_priority();
+        update(index);
+        return index;
+    }
+
+    void free_tree(NodeIndex index) {
+        if (index == NIL)
+            return;
+        free_tree(nodes[index].left);
+        free_tree(nodes[index].right);
+        free_nodes.push_back(index);
+    }
+
+    void update(NodeIndex index) {
+        auto& node = nodes[index];
+        node.length =
+            nodes[node.left].length +
+            node.piece.length +
+            nodes[node.right].length;
+        node.line_feeds =
+            nodes[node.left].line_feeds +
+            node.piece.line_feeds +
+            nodes[node.right].line_feeds;
+    }
+
+    // left gets the first pos chars of the tree, right gets the rest
+    void split(NodeIndex index, size_t pos, NodeIndex& left, NodeIndex& right) {
+        if (index == NIL) {
+            left = right = NIL;
+            return;
+        }
+
+        auto left_length = nodes[nodes[index].left].length;
+        auto piece = nodes[index].piece;
+        if (pos <= left_length) {
+            NodeIndex l;
+            split(nodes[index].left, pos, left, l);
+            nodes[index].left = l;
+            right = index;
+        }
+        else if (pos >= left_length + piece.length) {
+            NodeIndex r;
+            split(nodes[index].right, pos - left_length - piece.length, r, right);
+            nodes[index].right = r;
+            left = index;
+        }
+        else {
+            // the split point is inside the piece
+            auto k = pos - left_length;
+            auto tail = new_node(make_piece(piece.buffer, piece.start + k, piece.length - k));
+            nodes[index].piece = make_piece(piece.buffer, piece.start, k);
+            right = merge(tail, nodes[index].right);
+            nodes[index].right = NIL;
+            left = index;
+        }
+        update(index);
+    }
+
+    NodeIndex merge(NodeIndex left, NodeIndex right) {
+        if (left == NIL)
+            return right;
+        if (right == NIL)
+            return left;
+        if (nodes[left].priority > nodes[right].priority) {
+            auto r = merge(nodes[left].right, right);
+            nodes[left].right = r;
+            update(left);
+            return left;
+        }
+        else {
+            auto l = merge(left, nodes[right].left);
+            nodes[right].left = l;
+            update(right);
+            return right;
+        }
+    }
+
+    void collect_pieces(NodeIndex index, std::vector<Piece>& pieces) const {
+        if (index == NIL)
+            return;
+        collect_pieces(nodes[index].left, pieces);
+        pieces.push_back(nodes[index].piece);
+        collect_pieces(nodes[index].right, pieces);
+    }
+
+    // call f(const Piece& piece, size_t first, size_t count) on the parts
+    // of the pieces in [first, last), first is relative to the piece
+    template <typename Function>
+    bool for_each_piece(
+        NodeIndex index, size_t offset,
+        size_t first, size_t last,
+        Function& f
+    ) const {
+        if (index == NIL)
+            return true;
+        auto& node = nodes[index];
+        auto piece_first = offset + nodes[node.left].length;
+        auto piece_last = piece_first + node.piece.length;
+
+        if (first < piece_first &&
+            !for_each_piece(node.left, offset, first, last, f))
+            return false;
+        if (first < piece_last && last > piece_first) {
+            auto l = std::max(first, piece_first);
+            auto r = std::min(last, piece_last);
+            if (!f(node.piece, l - piece_first, r - l))
+                return false;
+        }
+        if (last > piece_last)
+            return for_each_piece(node.right, piece_last, first, last, f);
+        return true;
+    }
+};
\ No newline at end of file
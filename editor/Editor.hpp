@@ -3,8 +3,16 @@
 #include "TextArea.hpp"
 #include "LineNumDisplay.hpp"
 #include "StatusBar.hpp"
+#include "MappedFile.hpp"
+#include "FileSaver.hpp"
+#include "FileLoader.hpp"
+#include "File.hpp"
+#include "Clipboard.hpp"
 
-#include <fstream>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 class Editor {
     TextArea text_area;
@@ -19,7 +27,24 @@ class Editor {
         INPUTING_FILE_NAME
     } status = EDITING;
 
-    bool should_quit = false;
+    std::atomic<bool> should_quit{ false };
+
+    // the file which is still being loaded
+    std::unique_ptr<FileLoader> file_loader;
+    std::atomic<bool> loading{ false };
+
+    FileSaver file_saver;
+    // ctrl+s was pressed while saving
+    bool save_again = false;
+
+    // the file is saved with the line breaks it was loaded with
+    bool crlf = NATIVE_CRLF;
+
+    // how often the progress of loading and saving is shown
+    static constexpr auto PROGRESS_INTERVAL = std::chrono::milliseconds(100);
+
+    // the bars are drawn above the text
+    static constexpr int BAR_LAYER = 1;
 
 public:
     Editor() :
@@ -28,10 +53,10 @@ public:
         file_name_bar(0, 0, 119, 1),
         status_bar(0, 29, 119) {
 
-        io.set_char_callback(
-            [this](wchar_t ch) {
-                text_area.process_char(ch);
-                file_name_bar.process_char(ch);
+        io.set_text_callback(
+            [this](const wchar_t* chars, size_t count) {
+                text_area.process_text(chars, count);
+                file_name_bar.process_text(chars, count);
             }
         );
 
@@ -70,6 +95,14 @@ public:
             }
         );
 
+        // other programs can read what was copied only after leaving the editor
+        io.set_focus_callback(
+            [](bool focused) {
+                if (!focused)
+                    Clipboard::get_instance().publish();
+            }
+        );
+
         io.set_window_size_callback(
             [&](SHORT width, SHORT height) {
                 text_area.set_width(width - 9);
@@ -89,6 +122,11 @@ public:
 
     void loop() {
         while (!should_quit) {
+            // the input of the frame changes the components before they render
+            io.dispatch_events();
+            if (should_quit)
+                break;
+
             switch (status) {
             case Editor::EDITING:
                 text_area.set_active(true);
@@ -102,97 +140,158 @@ public:
                 break;
             }
 
-            text_area.render();
+            text_area.draw();
 
-            line_num_display.first_line_num = text_area.get_first_line() + 1;
-            line_num_display.current_line_num = text_area.get_current_line() + 1;
-            line_num_display.last_line_num = text_area.get_line_count() + 1;
-            line_num_display.render();
+            line_num_display.set_lines(
+                text_area.get_first_line() + 1,
+                text_area.get_current_line() + 1,
+                text_area.get_line_count() + 1
+            );
+            line_num_display.set_loading(loading);
+            line_num_display.draw();
 
-            file_name_bar.render();
+            file_name_bar.draw(BAR_LAYER);
 
-            status_bar.line = text_area.get_current_line() + 1;
-            status_bar.character = text_area.get_current_char() + 1;
-            status_bar.render();
+            status_bar.set_position(
+                int(text_area.get_current_line() + 1),
+                int(text_area.get_current_char() + 1)
+            );
+            update_load_status();
+            update_save_status();
+            status_bar.draw(BAR_LAYER);
 
             io.render();
-            Sleep(10);
+
+            // sleep until the input changes something or the cursor blinks
+            auto deadline = std::min(text_area.get_deadline(), file_name_bar.get_deadline());
+            if (loading || file_saver.get_state() == FileSaver::State::SAVING)
+                deadline = std::min(deadline, Cursor::Clock::now() + PROGRESS_INTERVAL);
+            if (!should_quit)
+                io.wait_for_events(deadline);
         }
+
+        Clipboard::get_instance().publish();
+    }
+
+    // leave the loop, may be called from a signal handler
+    void quit() {
+        should_quit = true;
+        io.wake();
     }
 
+    // the file is written in the background
     bool save_to_file() {
-        std::ofstream fout(file_name_bar.get_wstring());
-        if (fout.is_open())
-            fout << text_area.get_utf_8_string();
-        else return false;
-        fout.close();
-        return true;
+        if (loading)
+            return false;
+        if (file_saver.get_state() == FileSaver::State::SAVING) {
+            save_again = true;
+            return true;
+        }
+        return file_saver.save(text_area.get_snapshot(), file_name_bar.get_wstring(), crlf);
     }
 
     bool save_to_temp_file() {
-        HANDLE htemp = CreateFileW(
-            (file_name_bar.get_wstring() + L".temp").c_str(),
-            GENERIC_WRITE,
-            0,
-            NULL,
-            CREATE_ALWAYS,
-            FILE_ATTRIBUTE_HIDDEN,
-            NULL
-        );
-
-        if (htemp == INVALID_HANDLE_VALUE)
+        if (loading)
             return false;
-
-        auto content = text_area.get_utf_8_string();
-        DWORD bytes_written;
-        WriteFile(
-            htemp,
-            content.c_str(),
-            content.length(),
-            &bytes_written,
-            NULL
-        );
-        return true;
+        return write_to_file(file_name_bar.get_wstring() + L".temp", true);
     }
 
     bool read_from_temp_file(const std::wstring& file) {
-        std::ifstream fin(file + L".temp");
-        std::string str;
-        if (!fin.is_open())
-            return false;
-        while (!fin.eof()) {
-            std::string line;
-            std::getline(fin, line);
-            str += line + '\n';
+        {
+            MappedFile mapped_file(file + L".temp");
+            if (!mapped_file.is_open())
+                return false;
+            text_area.set_utf_8_string(mapped_file.get_data(), mapped_file.get_size());
+            crlf = FileLoader::is_crlf(mapped_file.get_data(), mapped_file.get_size());
         }
-        fin.close();
-
-        text_area.set_utf_8_string(str);
         file_name_bar.set_wstring(file);
 
-        DeleteFileW((file + L".temp").c_str());
+        File::remove(file + L".temp");
 
         return true;
     }
 
+    // the first screen is shown at once, the rest of the file
+    // is loaded in the background
     bool read_from_file(const std::wstring& file) {
-        std::ifstream fin(file);
-        std::string str;
-        if (!fin.is_open())
-            return false; 
-        while (!fin.eof()) {
-            std::string line;
-            std::getline(fin, line);
-            str += line + '\n';
-        }
-        fin.close();
-
-        text_area.set_utf_8_string(str);
+        auto loader = std::make_unique<FileLoader>(file);
+        if (!loader->is_open())
+            return false;
+        text_area.set_chunk(loader->load_head(text_area.get_height()));
         file_name_bar.set_wstring(file);
+        crlf = loader->is_crlf();
+
+        loader->start();
+        if (!loader->is_finished()) {
+            file_loader = std::move(loader);
+            loading = true;
+            text_area.set_read_only(true);
+        }
 
         return true;
     }
 
+private:
+    void update_load_status() {
+        if (!file_loader)
+            return;
+
+        // the chunks taken after seeing the loader finished are the last ones
+        bool finished = file_loader->is_finished();
+        for (auto& chunk : file_loader->take_chunks())
+            text_area.append_chunk(std::move(chunk));
+        status_bar.set_message(L"ڼ " + std::to_wstring(file_loader->get_progress()) + L"%");
+
+        if (finished) {
+            file_loader.reset();
+            loading = false;
+            text_area.set_read_only(false);
+            status_bar.set_message(L"");
+        }
+    }
+
+    void update_save_status() {
+        switch (file_saver.get_state()) {
+        case FileSaver::State::SAVING:
+            status_bar.set_message(L"ڱ " + std::to_wstring(file_saver.get_progress()) + L"%");
+            break;
+        case FileSaver::State::SUCCEEDED:
+            status_bar.set_message(L"ѱ");
+            break;
+        case FileSaver::State::UNSYNCED:
+            status_bar.set_message(L"ѱ棬δȷд");
+            break;
+        case FileSaver::State::FAILED:
+            status_bar.set_message(L"ʧ");
+            break;
+        default:
+            break;
+        }
+
+        if (save_again && file_saver.get_state() != FileSaver::State::SAVING) {
+            save_again = false;
+            save_to_file();
+        }
+    }
+
+    // encode the text and write it block by block
+    bool write_to_file(const std::wstring& file, bool hidden) {
+        File output;
+        if (!output.create(file, hidden))
+            return false;
+
+        bool succeeded = true;
+        auto sink = [&output, &succeeded](const char* bytes, size_t count) {
+            if (succeeded && !output.write(bytes, count))
+                succeeded = false;
+        };
+        Utf8Writer<decltype(sink)> writer(sink, crlf);
+        text_area.write_utf_8(writer);
+
+        return succeeded;
+    }
+
+public:
     ~Editor() {}
 };
 
@@ -0,0 +1,247 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "Utf8.hpp"
+
+#include <string>
+#ifndef _WIN32
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+// a file opened for writing
+// hidden files are marked with the attribute on windows, on the
+// other platforms the name decides it, so the flag is ignored
+class File {
+#ifdef _WIN32
+    HANDLE hfile = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+
+public:
+    File() {}
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    // create the file or truncate the existing one
+    bool create(const std::wstring& file, bool hidden = false) {
+        close();
+#ifdef _WIN32
+        hfile = CreateFileW(
+            file.c_str(),
+            GENERIC_WRITE,
+            0,
+            NULL,
+            CREATE_ALWAYS,
+            hidden ? FILE_ATTRIBUTE_HIDDEN : FILE_ATTRIBUTE_NORMAL,
+            NULL
+        );
+        return hfile != INVALID_HANDLE_VALUE;
+#else
+        (void)hidden;
+        fd = ::open(native_path(file).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        return fd >= 0;
+#endif
+    }
+
+    // create the file, fail if it exists already
+    bool create_new(const std::wstring& file) {
+        close();
+#ifdef _WIN32
+        hfile = CreateFileW(
+            file.c_str(),
+            GENERIC_WRITE,
+            0,
+            NULL,
+            CREATE_NEW,
+            FILE_ATTRIBUTE_NORMAL,
+            NULL
+        );
+        return hfile != INVALID_HANDLE_VALUE;
+#else
+        fd = ::open(native_path(file).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        return fd >= 0;
+#endif
+    }
+
+    // give the file the permissions and the owner of another one, as far
+    // as the process may give them away, nothing is done if that one does
+    // not exist
+    void copy_permissions(const std::wstring& file) {
+#ifdef _WIN32
+        (void)file;
+#else
+        struct stat st;
+        if (::stat(native_path(file).c_str(), &st) != 0)
+            return;
+        // the group alone when the owner cannot be given away
+        if (fchown(fd, st.st_uid, st.st_gid) != 0) {
+            auto result = fchown(fd, uid_t(-1), st.st_gid);
+            (void)result;
+        }
+        // after fchown, which may clear the set-user-id bits
+        auto result = fchmod(fd, st.st_mode & 07777);
+        (void)result;
+#endif
+    }
+
+    bool write(const char* bytes, size_t count) {
+#ifdef _WIN32
+        DWORD bytes_written;
+        return WriteFile(hfile, bytes, DWORD(count), &bytes_written, NULL) &&
+            bytes_written == count;
+#else
+        while (count > 0) {
+            auto n = ::write(fd, bytes, count);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            bytes += n;
+            count -= size_t(n);
+        }
+        return true;
+#endif
+    }
+
+    // wait until the data is on the disk
+    bool sync() {
+#ifdef _WIN32
+        return FlushFileBuffers(hfile);
+#else
+        return fsync(fd) == 0;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (hfile != INVALID_HANDLE_VALUE)
+            CloseHandle(hfile);
+        hfile = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+    }
+
+    ~File() {
+        close();
+    }
+
+    static bool remove(const std::wstring& file) {
+#ifdef _WIN32
+        return DeleteFileW(file.c_str());
+#else
+        return ::unlink(native_path(file).c_str()) == 0;
+#endif
+    }
+
+    // move source over target, which is replaced if it exists
+    // on windows the rename is on the disk when this returns, on the
+    // other platforms only after sync_directory(target)
+    static bool replace(const std::wstring& source, const std::wstring& target) {
+#ifdef _WIN32
+        return MoveFileExW(
+            source.c_str(),
+            target.c_str(),
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+        );
+#else
+        return ::rename(native_path(source).c_str(), native_path(target).c_str()) == 0;
+#endif
+    }
+
+    // wait until the directory which holds the file is on the disk, with
+    // the names which were moved into it
+    static bool sync_directory(const std::wstring& file) {
+#ifdef _WIN32
+        // the write through of replace() covers it
+        (void)file;
+        return true;
+#else
+        auto dir_fd = ::open(get_directory(native_path(file)).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0)
+            return false;
+        bool synced = fsync(dir_fd) == 0;
+        ::close(dir_fd);
+        return synced;
+#endif
+    }
+
+    // the file which the path leads to through symbolic links, so that
+    // replacing it keeps the links, the path itself if it is no link
+    static std::wstring resolve(const std::wstring& file) {
+#ifdef _WIN32
+        HANDLE handle = CreateFileW(
+            file.c_str(),
+            0,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL,
+            OPEN_EXISTING,
+            FILE_FLAG_BACKUP_SEMANTICS,
+            NULL
+        );
+        if (handle == INVALID_HANDLE_VALUE)
+            return file;
+        std::wstring path(MAX_PATH, L'\0');
+        auto length = GetFinalPathNameByHandleW(handle, &path[0], DWORD(path.size()), FILE_NAME_NORMALIZED);
+        if (length >= path.size()) {
+            path.resize(length);
+            length = GetFinalPathNameByHandleW(handle, &path[0], DWORD(path.size()), FILE_NAME_NORMALIZED);
+        }
+        CloseHandle(handle);
+        if (length == 0 || length >= path.size())
+            return file;
+        path.resize(length);
+        return path;
+#else
+        // a link may lead to a file which does not exist yet, so the links
+        // are followed one by one instead of through realpath
+        auto path = native_path(file);
+        for (int i = 0; i < MAX_LINK_COUNT; ++i) {
+            char link[PATH_MAX];
+            auto length = ::readlink(path.c_str(), link, sizeof(link) - 1);
+            if (length < 0)
+                break;
+            std::string next(link, size_t(length));
+            if (next[0] != '/' && path.find('/') != std::string::npos)
+                next = path.substr(0, path.rfind('/') + 1) + next;
+            path = next;
+        }
+        std::wstring wpath(path.size(), L'\0');
+        wpath.resize(Utf8::decode(path.data(), path.size(), &wpath[0]));
+        return wpath;
+#endif
+    }
+
+#ifndef _WIN32
+    // as many as the system follows
+    static constexpr int MAX_LINK_COUNT = 40;
+
+    static std::string get_directory(const std::string& path) {
+        auto slash = path.rfind('/');
+        if (slash == std::string::npos)
+            return ".";
+        if (slash == 0)
+            return "/";
+        return path.substr(0, slash);
+    }
+
+    // the file names are utf-8 on the other platforms
+    static std::string native_path(const std::wstring& file) {
+        std::string path;
+        path.reserve(file.size());
+        char bytes[4];
+        for (auto ch : file)
+            path.append(bytes, Utf8::encode(uint32_t(ch), bytes));
+        return path;
+    }
+#endif
+};
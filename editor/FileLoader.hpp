@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "Document.hpp"
+#include "MappedFile.hpp"
+#include "Utf8.hpp"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstring>
+
+// decodes a file progressively
+// the beginning of the file is decoded at once, so that the first screen
+// can be shown immediately, the rest is decoded on a worker thread in
+// chunks which the editor appends to the document as they get ready
+class FileLoader {
+    // the number of bytes decoded into one chunk
+    static constexpr size_t CHUNK_SIZE = 4 << 20;
+
+    MappedFile mapped_file;
+    size_t head_size = 0;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::vector<Document::Chunk> chunks;
+    std::atomic<size_t> bytes_decoded{ 0 };
+    std::atomic<bool> finished{ false };
+    std::atomic<bool> cancelled{ false };
+
+public:
+    FileLoader(const std::wstring& file) :
+        mapped_file(file) {}
+
+    FileLoader(const FileLoader&) = delete;
+    FileLoader& operator=(const FileLoader&) = delete;
+
+    bool is_open() {
+        return mapped_file.is_open();
+    }
+
+    // the file breaks its lines with "\r\n", as its first line break does,
+    // a file without line breaks takes the native ones
+    static bool is_crlf(const char* data, size_t size) {
+        auto line_feed = static_cast<const char*>(std::memchr(data, '\n', size));
+        if (!line_feed)
+            return NATIVE_CRLF;
+        return line_feed > data && line_feed[-1] == '\r';
+    }
+
+    bool is_crlf() {
+        return is_crlf(mapped_file.get_data(), mapped_file.get_size());
+    }
+
+    // decode the lines which fill the first screen
+    Document::Chunk load_head(size_t line_count) {
+        auto data = mapped_file.get_data();
+        auto size = mapped_file.get_size();
+        size_t end = 0;
+        for (size_t i = 0; i < line_count && end < size && end < CHUNK_SIZE; ++i) {
+            auto line_feed = static_cast<const char*>(std::memchr(data + end, '\n', size - end));
+            end = line_feed ? line_feed - data + 1 : size;
+        }
+        head_size = chunk_end(0, end);
+        bytes_decoded = head_size;
+        return decode(0, head_size);
+    }
+
+    // decode the rest of the file in the background
+    void start() {
+        if (head_size == mapped_file.get_size()) {
+            finished = true;
+            return;
+        }
+        worker = std::thread(&FileLoader::decode_rest, this);
+    }
+
+    // the chunks which have been decoded since the last call
+    std::vector<Document::Chunk> take_chunks() {
+        std::vector<Document::Chunk> taken;
+        std::lock_guard<std::mutex> lock(mutex);
+        taken.swap(chunks);
+        return taken;
+    }
+
+    // all the chunks have been decoded,
+    // call take_chunks() once more to get the last ones
+    bool is_finished() {
+        return finished;
+    }
+
+    // 0 to 100
+    int get_progress() {
+        auto size = mapped_file.get_size();
+        if (size == 0)
+            return 100;
+        return int(bytes_decoded * 100 / size);
+    }
+
+    ~FileLoader() {
+        cancelled = true;
+        if (worker.joinable())
+            worker.join();
+    }
+
+private:
+    // move the end of a chunk backwards, so that neither a utf-8 sequence
+    // nor a "\r\n" is split between two chunks
+    size_t chunk_end(size_t first, size_t end) {
+        auto data = reinterpret_cast<const unsigned char*>(mapped_file.get_data());
+        auto size = mapped_file.get_size();
+        if (end >= size)
+            return size;
+        auto last = end;
+        for (int i = 0; i < 3 && last > first && (data[last] & 0b1100'0000) == 0b1000'0000; ++i)
+            --last;
+        if (last > first && data[last - 1] == '\r')
+            --last;
+        return last > first ? last : end;
+    }
+
+    Document::Chunk decode(size_t first, size_t last) {
+        auto data = mapped_file.get_data() + first;
+        auto char_count = Utf8::decode(data, last - first, nullptr);
+        std::unique_ptr<Document::Char[]> chars(new Document::Char[char_count]);
+        Utf8::decode(data, last - first, chars.get());
+        return Document::Chunk(std::move(chars), char_count);
+    }
+
+    void decode_rest() {
+        auto size = mapped_file.get_size();
+        size_t first = head_size;
+        while (first < size && !cancelled) {
+            auto last = chunk_end(first, first + CHUNK_SIZE);
+            auto chunk = decode(first, last);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunks.push_back(std::move(chunk));
+            }
+            bytes_decoded = last;
+            first = last;
+        }
+        finished = true;
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Document.hpp"
+#include "Utf8.hpp"
+#include "File.hpp"
+
+#include <thread>
+#include <atomic>
+#include <string>
+
+// writes a snapshot of the document on a worker thread
+// the text goes to a new temporary file next to the target, which replaces
+// the target only after it was completely written and flushed to disk,
+// so a crash during saving never leaves a truncated file behind
+// the new file takes the permissions and the owner of the old one, and a
+// symbolic link is kept, the file it leads to is replaced
+class FileSaver {
+public:
+    enum class State {
+        IDLE,
+        SAVING,
+        SUCCEEDED,
+        // the file was replaced, but its directory could not be flushed,
+        // so a crash may still bring the old file back
+        UNSYNCED,
+        FAILED
+    };
+
+private:
+    // the progress is reported after every this many chars
+    static constexpr size_t PROGRESS_STEP = 1 << 20;
+    // the names tried for the temporary file, before giving up
+    static constexpr int MAX_TEMP_FILE_COUNT = 100;
+
+    std::thread worker;
+    std::atomic<State> state{ State::IDLE };
+    std::atomic<size_t> chars_written{ 0 };
+    size_t chars_total = 0;
+
+public:
+    FileSaver() {}
+    FileSaver(const FileSaver&) = delete;
+    FileSaver& operator=(const FileSaver&) = delete;
+
+    // return false if the last save has not finished yet
+    // with crlf, the line breaks are written as "\r\n"
+    bool save(Document::Snapshot snapshot, std::wstring file, bool crlf) {
+        if (state == State::SAVING)
+            return false;
+        if (worker.joinable())
+            worker.join();
+
+        chars_total = snapshot.size();
+        chars_written = 0;
+        state = State::SAVING;
+        worker = std::thread(
+            [this, snapshot = std::move(snapshot), file = std::move(file), crlf] {
+                state = write(snapshot, file, crlf);
+            }
+        );
+        return true;
+    }
+
+    State get_state() {
+        return state;
+    }
+
+    // 0 to 100
+    int get_progress() {
+        if (chars_total == 0)
+            return 100;
+        return int(chars_written * 100 / chars_total);
+    }
+
+    ~FileSaver() {
+        if (worker.joinable())
+            worker.join();
+    }
+
+private:
+    // a new file next to the target, a file which has the name already
+    // is never touched, the next name is tried instead
+    static bool create_temp_file(File& output, const std::wstring& file, std::wstring& temp_file) {
+        for (int i = 0; i < MAX_TEMP_FILE_COUNT; ++i) {
+            temp_file = file + L".saving";
+            if (i > 0)
+                temp_file += std::to_wstring(i);
+            if (output.create_new(temp_file))
+                return true;
+        }
+        return false;
+    }
+
+    State write(const Document::Snapshot& snapshot, const std::wstring& link, bool crlf) {
+        // a symbolic link stays, the file it leads to is replaced
+        auto file = File::resolve(link);
+        std::wstring temp_file;
+        File output;
+        if (!create_temp_file(output, file, temp_file))
+            return State::FAILED;
+        // before any text is written, so a private file stays private
+        output.copy_permissions(file);
+
+        bool succeeded = true;
+        auto sink = [&output, &succeeded](const char* bytes, size_t count) {
+            if (succeeded && !output.write(bytes, count))
+                succeeded = false;
+        };
+        Utf8Writer<decltype(sink)> writer(sink, crlf);
+        snapshot.for_each_span(
+            [this, &writer, &succeeded](const Document::Char* chars, size_t count) {
+                while (count > 0 && succeeded) {
+                    auto n = count < PROGRESS_STEP ? count : PROGRESS_STEP;
+                    writer.write(chars, n);
+                    chars_written += n;
+                    chars += n;
+                    count -= n;
+                }
+                return succeeded;
+            }
+        );
+        writer.flush();
+
+        succeeded = succeeded && output.sync();
+        output.close();
+
+        // once the rename is done the target holds the new text, whatever
+        // becomes of flushing the directory
+        if (!succeeded || !File::replace(temp_file, file)) {
+            File::remove(temp_file);
+            return State::FAILED;
+        }
+        return File::sync_directory(file) ? State::SUCCEEDED : State::UNSYNCED;
+    }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Platform.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+// the cells of a frame, one per screen column
+// the chars and the attributes are kept in arrays of their own, so that
+// clearing, filling and comparing run over contiguous memory of a single
+// type and vectorize, the screens convert the cells to their own format
+// when they write them
+class FrameBuffer {
+    SHORT width = 0;
+    SHORT height = 0;
+    std::vector<wchar_t> chars;
+    std::vector<WORD> attributes;
+
+public:
+    void resize(SHORT width, SHORT height) {
+        this->width = width;
+        this->height = height;
+        chars.assign(size_t(width) * height, ' ');
+        attributes.assign(size_t(width) * height, 0);
+    }
+
+    SHORT get_width() const {
+        return width;
+    }
+    SHORT get_height() const {
+        return height;
+    }
+
+    wchar_t* get_chars(SHORT y) {
+        return chars.data() + size_t(y) * width;
+    }
+    const wchar_t* get_chars(SHORT y) const {
+        return chars.data() + size_t(y) * width;
+    }
+    WORD* get_attributes(SHORT y) {
+        return attributes.data() + size_t(y) * width;
+    }
+    const WORD* get_attributes(SHORT y) const {
+        return attributes.data() + size_t(y) * width;
+    }
+
+    // every cell becomes a space on the background color, the foreground
+    // of a space does not show, so the attributes are one value to fill
+    void clear(WORD background_color) {
+        fill(chars, L' ');
+        fill(attributes, WORD(background_color << 4));
+    }
+
+    // set the background color of count attributes
+    static void fill_background(WORD* attributes, size_t count, WORD background_color) {
+        WORD background = WORD(background_color << 4);
+        for (size_t i = 0; i < count; ++i)
+            attributes[i] = (attributes[i] & 0xff0f) | background;
+    }
+
+    bool is_same_row(const FrameBuffer& other, SHORT y) const {
+        return
+            std::memcmp(get_chars(y), other.get_chars(y), width * sizeof(wchar_t)) == 0 &&
+            std::memcmp(get_attributes(y), other.get_attributes(y), width * sizeof(WORD)) == 0;
+    }
+
+    bool is_same_cell(const FrameBuffer& other, size_t i) const {
+        return chars[i] == other.chars[i] && attributes[i] == other.attributes[i];
+    }
+
+    // the buffers are of the same size, no memory is allocated
+    void copy_from(const FrameBuffer& other) {
+        std::copy(other.chars.begin(), other.chars.end(), chars.begin());
+        std::copy(other.attributes.begin(), other.attributes.end(), attributes.begin());
+    }
+
+private:
+    // a row is filled, and then copied over the rest in doubling blocks,
+    // memcpy is vectorized where a loop filling a pattern wider than a
+    // byte may not be
+    template <typename T>
+    void fill(std::vector<T>& cells, T value) {
+        if (cells.empty())
+            return;
+        size_t filled = std::min(cells.size(), size_t(width));
+        std::fill(cells.begin(), cells.begin() + filled, value);
+        while (filled < cells.size()) {
+            auto count = std::min(filled, cells.size() - filled);
+            std::memcpy(cells.data() + filled, cells.data(), count * sizeof(T));
+            filled += count;
+        }
+    }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "InputQueue.hpp"
+#include "HeadlessScreen.hpp"
+
+#include <string>
+
+// input which is given by a script instead of a console
+// the events are reported as the console would report them, they are
+// queued for the main thread, which takes them in dispatch_events()
+// the queue has a single producer, so the script runs on one thread,
+// which must not be the main thread once the queue can fill up
+class HeadlessInput : public InputQueue {
+public:
+    bool failed_to_init() const {
+        return false;
+    }
+
+    // a key which types no char, like the arrows
+    void press(WORD vk_code, DWORD state = 0) {
+        keydown(vk_code, state);
+        notify();
+    }
+
+    // every char comes with the keydown of its key
+    void type(const std::wstring& text) {
+        for (auto ch : text) {
+            if (ch == '\r' || ch == '\n') {
+                keydown(VK_RETURN, 0, true);
+                character('\r');
+            }
+            else if (ch == '\t') {
+                keydown(VK_TAB, 0, true);
+                character('\t');
+            }
+            else {
+                WORD vk_code = 0;
+                if (ch >= 'a' && ch <= 'z')
+                    vk_code = WORD(ch - 'a' + 'A');
+                else if ((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9'))
+                    vk_code = WORD(ch);
+                keydown(vk_code, 0, true);
+                character(ch);
+            }
+        }
+        notify();
+    }
+
+    void resize(SHORT width, SHORT height) {
+        HeadlessScreen::resize_window(width, height);
+        window_size(width, height);
+        notify();
+    }
+
+    void set_focus(bool focused) {
+        focus(focused);
+        notify();
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "FrameBuffer.hpp"
+
+#include <atomic>
+#include <string>
+#include <algorithm>
+
+// a screen in memory, for running the editor without a console
+// it keeps the cells as a terminal would show them, with the escape
+// sequences and the number of frames and cells which were written
+class HeadlessScreen {
+    // the size of the window, which HeadlessInput changes
+    inline static std::atomic<SHORT> window_width{ 80 };
+    inline static std::atomic<SHORT> window_height{ 24 };
+
+    FrameBuffer cells;
+    std::string sequences;
+    size_t frame_count = 0;
+    size_t cell_count = 0;
+
+public:
+    static void resize_window(SHORT width, SHORT height) {
+        window_width = width;
+        window_height = height;
+    }
+
+    COORD get_size() {
+        return { window_width, window_height };
+    }
+
+    void set_size(COORD size) {
+        cells.resize(size.X, size.Y);
+    }
+
+    void write(const FrameBuffer& frame, SHORT first, SHORT last, SHORT y) {
+        if (y >= cells.get_height() || frame.get_width() != cells.get_width())
+            return;
+        std::copy(frame.get_chars(y) + first, frame.get_chars(y) + last, cells.get_chars(y) + first);
+        std::copy(frame.get_attributes(y) + first, frame.get_attributes(y) + last, cells.get_attributes(y) + first);
+        cell_count += last - first;
+    }
+
+    void write_sequence(const std::string& sequence) {
+        sequences += sequence;
+    }
+
+    void end_frame() {
+        ++frame_count;
+    }
+
+    // what is shown, continuation cells hold CONTINUATION_CHAR
+    const FrameBuffer& get_cells() const {
+        return cells;
+    }
+
+    std::wstring get_row(SHORT y) const {
+        std::wstring row;
+        auto chars = cells.get_chars(y);
+        for (SHORT x = 0; x < cells.get_width(); ++x)
+            if (chars[x] != CONTINUATION_CHAR)
+                row += chars[x];
+        return row;
+    }
+
+    const std::string& get_sequences() const {
+        return sequences;
+    }
+
+    size_t get_frame_count() const {
+        return frame_count;
+    }
+
+    size_t get_cell_count() const {
+        return cell_count;
+    }
+};
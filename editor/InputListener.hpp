@@ -1,33 +1,65 @@
 #pragma once
 
-#include <Windows.h>
+#include "InputQueue.hpp"
+#include "Utf8.hpp"
+
 #include <thread>
-#include <functional>
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <string>
+#endif
 
-class InputListener {
+// reads the console input on its own thread and turns it into events,
+// the keys are reported as windows virtual key codes
+// on the other platforms the terminal is put in raw mode and the vt
+// sequences which it sends are translated, SIGWINCH reports the size
+class InputListener :
+    public InputQueue {
+#ifdef _WIN32
     HANDLE hstdin;
     bool _failed_to_init = false;
 
     static constexpr size_t INPUT_BUFFER_SIZE = 8;
     INPUT_RECORD input_buffer[INPUT_BUFFER_SIZE]{};
+#else
+    bool _failed_to_init = false;
 
-    std::thread listen_thread;
+    termios original_mode{};
+    bool raw_mode = false;
 
-public:
-    using KEYDOWN_CALLBACK = std::function<void(WORD vk_code, DWORD control_key_state)>;
-    using WINDOW_SIZE_CALLBACK = std::function<void(SHORT width, SHORT height)>;
-    using CHAR_CALLBACK = std::function<void(wchar_t ch)>;
+    // SIGWINCH and wake() write to the pipe to wake the listening thread
+    inline static int wake_pipe[2] = { -1, -1 };
+    static constexpr char RESIZE_BYTE = 0;
+    static constexpr char WAKE_BYTE = 1;
+    static constexpr char STOP_BYTE = 2;
 
-private:
-    KEYDOWN_CALLBACK keydown_callback = nullptr;
-    WINDOW_SIZE_CALLBACK window_size_callback = nullptr;
-    CHAR_CALLBACK char_callback = nullptr;
+    static constexpr size_t INPUT_BUFFER_SIZE = 256;
+    char input_buffer[INPUT_BUFFER_SIZE]{};
+
+    // the bytes of a sequence which has not been read completely
+    std::string pending;
+
+    // an escape which is not followed by more within this time
+    // is the escape key
+    static constexpr int ESCAPE_TIMEOUT = 30;
+#endif
+
+    // started last, the members above are in use at once
+    std::thread listen_thread;
 
 public:
+#ifdef _WIN32
     InputListener() :
         hstdin(GetStdHandle(STD_INPUT_HANDLE)),
         listen_thread(&InputListener::listen, this) {
-        if (!SetConsoleMode(hstdin, ENABLE_MOUSE_INPUT | ENABLE_EXTENDED_FLAGS))
+        // resizing is reported as an event, nothing polls the size
+        if (!SetConsoleMode(hstdin, ENABLE_WINDOW_INPUT | ENABLE_MOUSE_INPUT | ENABLE_EXTENDED_FLAGS))
             _failed_to_init = true;
         listen_thread.detach();
     }
@@ -35,18 +67,68 @@ public:
     bool failed_to_init() {
         return hstdin != INVALID_HANDLE_VALUE || _failed_to_init;
     }
+#else
+    InputListener() {
+        if (tcgetattr(STDIN_FILENO, &original_mode) == 0) {
+            auto mode = original_mode;
+            // no echo, no line editing, no signals and no flow control,
+            // so that ctrl+c, ctrl+s and ctrl+q reach the editor
+            mode.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+            mode.c_oflag &= ~OPOST;
+            mode.c_cflag |= CS8;
+            mode.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+            mode.c_cc[VMIN] = 1;
+            mode.c_cc[VTIME] = 0;
+            raw_mode = tcsetattr(STDIN_FILENO, TCSAFLUSH, &mode) == 0;
+        }
+        if (!raw_mode)
+            _failed_to_init = true;
 
-    void set_keydown_callback(KEYDOWN_CALLBACK callback) {
-        keydown_callback = callback;
+        // report ctrl and shift with the other keys where the terminal
+        // supports it, so that ctrl+shift+s differs from ctrl+s,
+        // and report the focus
+        write_all("\x1b[>4;2m\x1b[?1004h");
+
+        if (pipe(wake_pipe) == 0) {
+            fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+            struct sigaction action {};
+            action.sa_handler = [](int) {
+                write_wake_pipe(RESIZE_BYTE);
+            };
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            sigaction(SIGWINCH, &action, nullptr);
+        }
+
+        listen_thread = std::thread(&InputListener::listen, this);
+    }
+
+    bool failed_to_init() {
+        return _failed_to_init;
     }
-    void set_window_size_callback(WINDOW_SIZE_CALLBACK callback) {
-        window_size_callback = callback;
+
+    ~InputListener() {
+        // the thread stops at the byte instead of using the members after this
+        stopping = true;
+        if (wake_pipe[1] >= 0) {
+            write_wake_pipe(STOP_BYTE);
+            listen_thread.join();
+        }
+        else
+            listen_thread.detach();
+        write_all("\x1b[>4m\x1b[?1004l");
+        if (raw_mode)
+            tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_mode);
     }
-    void set_char_callback(CHAR_CALLBACK callback) {
-        char_callback = callback;
+
+    // end the wait, it is safe to call from a signal handler
+    void wake() {
+        write_wake_pipe(WAKE_BYTE);
     }
+#endif
 
 private:
+#ifdef _WIN32
     void listen() {
         while (true) {
             DWORD events_read;
@@ -62,30 +144,294 @@ private:
                 switch (event.EventType) {
                 case KEY_EVENT:
                     if (event.Event.KeyEvent.bKeyDown) {
-                        if (keydown_callback)
-                            keydown_callback(
-                                event.Event.KeyEvent.wVirtualKeyCode,
-                                event.Event.KeyEvent.dwControlKeyState
-                            );
-                        if (char_callback
-                            && (event.Event.KeyEvent.uChar.UnicodeChar > 31 ||
-                                event.Event.KeyEvent.uChar.UnicodeChar == '\r' ||
-                                event.Event.KeyEvent.uChar.UnicodeChar == '\t'))
-                            char_callback(event.Event.KeyEvent.uChar.UnicodeChar);
+                        auto ch = event.Event.KeyEvent.uChar.UnicodeChar;
+                        auto state = event.Event.KeyEvent.dwControlKeyState;
+                        bool is_char = ch > 31 || ch == '\r' || ch == '\t';
+                        constexpr DWORD CTRL_OR_ALT =
+                            LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED |
+                            LEFT_ALT_PRESSED | RIGHT_ALT_PRESSED;
+                        keydown(
+                            event.Event.KeyEvent.wVirtualKeyCode,
+                            state,
+                            is_char && !(state & CTRL_OR_ALT)
+                        );
+                        if (is_char)
+                            character(ch);
                     }
                     break;
                 case WINDOW_BUFFER_SIZE_EVENT:
-                    if (window_size_callback)
-                        window_size_callback(
-                            event.Event.WindowBufferSizeEvent.dwSize.X,
-                            event.Event.WindowBufferSizeEvent.dwSize.Y
-                        );
+                    window_size(
+                        event.Event.WindowBufferSizeEvent.dwSize.X,
+                        event.Event.WindowBufferSizeEvent.dwSize.Y
+                    );
+                    break;
+                case FOCUS_EVENT:
+                    focus(event.Event.FocusEvent.bSetFocus);
                     break;
                 default:
                     break;
                 }
             }
+            notify();
         }
     }
-};
+#else
+    void listen() {
+        while (true) {
+            pollfd fds[2] = {
+                { STDIN_FILENO, POLLIN, 0 },
+                { wake_pipe[0], POLLIN, 0 }
+            };
+            int ready = poll(fds, wake_pipe[0] >= 0 ? 2 : 1, pending.empty() ? -1 : ESCAPE_TIMEOUT);
+            if (ready < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            if (ready == 0) {
+                // nothing completed the sequence
+                pending.erase(0, parse(pending.data(), pending.size(), true));
+                notify();
+                continue;
+            }
+
+            if (fds[1].revents & POLLIN) {
+                char bytes[16];
+                auto count = ::read(wake_pipe[0], bytes, sizeof(bytes));
+                bool resized = false;
+                for (ssize_t i = 0; i < count; ++i) {
+                    if (bytes[i] == STOP_BYTE)
+                        return;
+                    resized = resized || bytes[i] == RESIZE_BYTE;
+                }
+                winsize ws{};
+                if (resized && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0)
+                    window_size(SHORT(ws.ws_col), SHORT(ws.ws_row));
+                notify();
+            }
+
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+                auto count = ::read(STDIN_FILENO, input_buffer, INPUT_BUFFER_SIZE);
+                if (count < 0 && errno == EINTR)
+                    continue;
+                if (count <= 0)
+                    return;
+                pending.append(input_buffer, size_t(count));
+                pending.erase(0, parse(pending.data(), pending.size(), false));
+                notify();
+            }
+        }
+    }
+
+    // report the keys in bytes, return the number of bytes used
+    // an incomplete sequence at the end is left for the next read,
+    // unless flush is set
+    size_t parse(const char* bytes, size_t size, bool flush) {
+        size_t i = 0;
+        while (i < size) {
+            auto used = parse_key(
+                reinterpret_cast<const unsigned char*>(bytes) + i, size - i, flush
+            );
+            if (used == 0)
+                break;
+            i += used;
+        }
+        return i;
+    }
+
+    // report one key, return the number of bytes it took or 0 if it
+    // is not complete
+    size_t parse_key(const unsigned char* bytes, size_t size, bool flush) {
+        auto ch = bytes[0];
+        if (ch == 0x1b) {
+            if (size == 1) {
+                if (!flush)
+                    return 0;
+                key(0x1b, 0);
+                return 1;
+            }
+            if (bytes[1] == '[')
+                return parse_csi(bytes, size, flush);
+            if (bytes[1] == 'O') {
+                if (size < 3)
+                    return flush ? (key(0x1b, 0), 1) : 0;
+                special_key(bytes[2], 0);
+                return 3;
+            }
+            // alt with a key
+            auto used = parse_key(bytes + 1, size - 1, flush);
+            return used == 0 ? 0 : used + 1;
+        }
+
+        if (ch < 0x80) {
+            key(ch, 0);
+            return 1;
+        }
+
+        // a utf-8 sequence
+        size_t length =
+            ch >= 0b1111'0000 ? 4 :
+            ch >= 0b1110'0000 ? 3 :
+            ch >= 0b1100'0000 ? 2 : 1;
+        if (size < length && !flush)
+            return 0;
+        if (length > size)
+            length = size;
+        wchar_t chars[4];
+        auto count = Utf8::decode(reinterpret_cast<const char*>(bytes), length, chars);
+        for (size_t i = 0; i < count; ++i)
+            key(uint32_t(chars[i]), 0);
+        return length;
+    }
+
+    // CSI parameters final
+    size_t parse_csi(const unsigned char* bytes, size_t size, bool flush) {
+        size_t i = 2;
+        int params[4] = { 0, 0, 0, 0 };
+        int param_count = 0;
+        for (; i < size; ++i) {
+            auto ch = bytes[i];
+            if (ch >= '0' && ch <= '9') {
+                if (param_count == 0)
+                    param_count = 1;
+                if (param_count <= 4)
+                    params[param_count - 1] = params[param_count - 1] * 10 + (ch - '0');
+            }
+            else if (ch == ';') {
+                ++param_count;
+            }
+            else if (ch >= 0x40 && ch <= 0x7e) {
+                break;
+            }
+            else if (ch < 0x20 || ch > 0x7e) {
+                // not a sequence after all
+                key(0x1b, 0);
+                return 1;
+            }
+        }
+        if (i == size) {
+            if (!flush)
+                return 0;
+            key(0x1b, 0);
+            return 1;
+        }
+
+        auto final_byte = bytes[i];
+        // the modifier parameter is 1 + shift + 2 * alt + 4 * ctrl
+        auto modifiers = [](int param) {
+            DWORD state = 0;
+            if (param > 1) {
+                if ((param - 1) & 1)
+                    state |= SHIFT_PRESSED;
+                if ((param - 1) & 2)
+                    state |= LEFT_ALT_PRESSED;
+                if ((param - 1) & 4)
+                    state |= LEFT_CTRL_PRESSED;
+            }
+            return state;
+        };
+
+        if (final_byte == '~') {
+            if (params[0] == 27 && param_count >= 3)
+                // xterm's modifyOtherKeys: 27;modifiers;code~
+                key(uint32_t(params[2]), modifiers(params[1]));
+            else
+                tilde_key(params[0], modifiers(params[1]));
+        }
+        else if ((final_byte == 'I' || final_byte == 'O') && param_count == 0) {
+            // the focus was gained or lost
+            focus(final_byte == 'I');
+        }
+        else if (final_byte == 'u') {
+            // code;modifiers u
+            key(uint32_t(params[0]), modifiers(params[1]));
+        }
+        else {
+            special_key(final_byte, modifiers(params[1]));
+        }
+        return i + 1;
+    }
 
+    void special_key(unsigned char final_byte, DWORD state) {
+        switch (final_byte) {
+        case 'A': keydown(VK_UP, state); break;
+        case 'B': keydown(VK_DOWN, state); break;
+        case 'C': keydown(VK_RIGHT, state); break;
+        case 'D': keydown(VK_LEFT, state); break;
+        case 'H': keydown(VK_HOME, state); break;
+        case 'F': keydown(VK_END, state); break;
+        default: break;
+        }
+    }
+
+    void tilde_key(int code, DWORD state) {
+        switch (code) {
+        case 1: case 7: keydown(VK_HOME, state); break;
+        case 4: case 8: keydown(VK_END, state); break;
+        case 3: keydown(VK_DELETE, state); break;
+        case 5: keydown(VK_PRIOR, state); break;
+        case 6: keydown(VK_NEXT, state); break;
+        default: break;
+        }
+    }
+
+    // report a code point as the console would: a keydown with the virtual
+    // key code, then the char if it is printable and no ctrl is held
+    void key(uint32_t ch, DWORD state) {
+        if (ch == '\r' || ch == '\n') {
+            bool types_char = !(state & LEFT_CTRL_PRESSED);
+            keydown(VK_RETURN, state, types_char && !(state & LEFT_ALT_PRESSED));
+            if (types_char)
+                character('\r');
+        }
+        else if (ch == '\t') {
+            bool types_char = !(state & LEFT_CTRL_PRESSED);
+            keydown(VK_TAB, state, types_char && !(state & LEFT_ALT_PRESSED));
+            if (types_char)
+                character('\t');
+        }
+        else if (ch == 0x7f || ch == '\b') {
+            keydown(VK_BACK, state);
+        }
+        else if (ch == 0x1b) {
+            keydown(VK_ESCAPE, state);
+        }
+        else if (ch >= 1 && ch <= 26) {
+            // ctrl with a letter
+            keydown(WORD('A' + ch - 1), state | LEFT_CTRL_PRESSED);
+        }
+        else if (ch >= 0x20) {
+            WORD vk_code = 0;
+            if (ch >= 'a' && ch <= 'z')
+                vk_code = WORD(ch - 'a' + 'A');
+            else if ((ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9'))
+                vk_code = WORD(ch);
+            bool types_char = !(state & (LEFT_CTRL_PRESSED | LEFT_ALT_PRESSED));
+            keydown(vk_code, state, types_char);
+            if (types_char)
+                character(wchar_t(ch));
+        }
+    }
+
+    static void write_wake_pipe(char byte) {
+        if (wake_pipe[1] < 0)
+            return;
+        auto result = ::write(wake_pipe[1], &byte, 1);
+        (void)result;
+    }
+
+    static void write_all(const char* str) {
+        auto size = std::char_traits<char>::length(str);
+        while (size > 0) {
+            auto n = ::write(STDOUT_FILENO, str, size);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            str += n;
+            size -= size_t(n);
+        }
+    }
+#endif
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "SpscRing.hpp"
+#include "Trace.hpp"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <string>
+
+// the events of an input backend, which produces them on a thread of its
+// own and passes them to the main thread through a lock-free ring
+// the main thread sleeps in wait_for_events() and then calls the callbacks
+// for all of them in dispatch_events(), so only the main thread touches
+// the components
+class InputQueue {
+    struct Event {
+        enum class Type : unsigned char {
+            KEYDOWN,
+            CHAR,
+            WINDOW_SIZE,
+            FOCUS
+        } type;
+        wchar_t ch;
+        WORD vk_code;
+        DWORD control_key_state;
+        SHORT width;
+        SHORT height;
+        // the keydown of a key which types the next char
+        bool types_char;
+#ifdef EDITOR_TRACE
+        Trace::Clock::time_point arrived{};
+#endif
+    };
+
+    static constexpr size_t EVENT_QUEUE_SIZE = 1024;
+    SpscRing<Event, EVENT_QUEUE_SIZE> events;
+
+    std::mutex events_mutex;
+    std::condition_variable events_changed;
+    bool has_events = false;
+
+protected:
+    // nobody will take the events any more
+    std::atomic<bool> stopping{ false };
+
+public:
+    using KEYDOWN_CALLBACK = std::function<void(WORD vk_code, DWORD control_key_state)>;
+    using WINDOW_SIZE_CALLBACK = std::function<void(SHORT width, SHORT height)>;
+    using CHAR_CALLBACK = std::function<void(wchar_t ch)>;
+    using TEXT_CALLBACK = std::function<void(const wchar_t* chars, size_t count)>;
+    using FOCUS_CALLBACK = std::function<void(bool focused)>;
+
+private:
+    KEYDOWN_CALLBACK keydown_callback = nullptr;
+    WINDOW_SIZE_CALLBACK window_size_callback = nullptr;
+    CHAR_CALLBACK char_callback = nullptr;
+    TEXT_CALLBACK text_callback = nullptr;
+    FOCUS_CALLBACK focus_callback = nullptr;
+
+    // the chars of the events being dispatched
+    std::wstring text;
+
+public:
+    void set_keydown_callback(KEYDOWN_CALLBACK callback) {
+        keydown_callback = callback;
+    }
+    void set_window_size_callback(WINDOW_SIZE_CALLBACK callback) {
+        window_size_callback = callback;
+    }
+    void set_char_callback(CHAR_CALLBACK callback) {
+        char_callback = callback;
+    }
+    // the chars typed one after another are reported at once,
+    // instead of through the char callback
+    void set_text_callback(TEXT_CALLBACK callback) {
+        text_callback = callback;
+    }
+    void set_focus_callback(FOCUS_CALLBACK callback) {
+        focus_callback = callback;
+    }
+
+    // block until events arrived since the last call,
+    // wake() was called or the deadline passed
+    template <typename TimePoint>
+    void wait_for_events(TimePoint deadline) {
+        std::unique_lock<std::mutex> lock(events_mutex);
+        auto ready = [this] { return has_events || !events.empty(); };
+        if (deadline == TimePoint::max())
+            events_changed.wait(lock, ready);
+        else
+            events_changed.wait_until(lock, deadline, ready);
+        has_events = false;
+    }
+
+    // call the callbacks for the events which have arrived,
+    // on the thread which renders
+    // consecutive chars are collected for the text callback, the keydowns
+    // of the keys which type them do not wait for the text before them
+    void dispatch_events() {
+        TRACE_SCOPE(DISPATCH);
+        Event event;
+        while (events.pop(event)) {
+            switch (event.type) {
+            case Event::Type::KEYDOWN:
+                TRACE_INPUT(event.arrived);
+                if (!event.types_char)
+                    dispatch_text();
+                if (keydown_callback)
+                    keydown_callback(event.vk_code, event.control_key_state);
+                break;
+            case Event::Type::CHAR:
+                if (text_callback)
+                    text.push_back(event.ch);
+                else if (char_callback)
+                    char_callback(event.ch);
+                break;
+            case Event::Type::WINDOW_SIZE:
+                dispatch_text();
+                if (window_size_callback)
+                    window_size_callback(event.width, event.height);
+                break;
+            case Event::Type::FOCUS:
+                dispatch_text();
+                if (focus_callback)
+                    focus_callback(event.ch != 0);
+                break;
+            }
+        }
+        dispatch_text();
+        TRACE_INPUTS_DISPATCHED();
+    }
+
+    // end the wait
+    void wake() {
+        notify();
+    }
+
+protected:
+    // the ring is only full when the main thread is busy for long,
+    // then the input waits for it instead of being lost
+    void push(Event event) {
+#ifdef EDITOR_TRACE
+        event.arrived = Trace::Clock::now();
+#endif
+        while (!events.push(event) && !stopping) {
+            notify();
+            std::this_thread::yield();
+        }
+    }
+
+    void keydown(WORD vk_code, DWORD state, bool types_char = false) {
+        push({ Event::Type::KEYDOWN, 0, vk_code, state, 0, 0, types_char });
+    }
+
+    void character(wchar_t ch) {
+        push({ Event::Type::CHAR, ch, 0, 0, 0, 0, false });
+    }
+
+    void window_size(SHORT width, SHORT height) {
+        push({ Event::Type::WINDOW_SIZE, 0, 0, 0, width, height, false });
+    }
+
+    void focus(bool focused) {
+        push({ Event::Type::FOCUS, wchar_t(focused), 0, 0, 0, 0, false });
+    }
+
+    void notify() {
+        {
+            std::lock_guard<std::mutex> lock(events_mutex);
+            has_events = true;
+        }
+        events_changed.notify_one();
+    }
+
+private:
+    void dispatch_text() {
+        if (text.empty())
+            return;
+        text_callback(text.data(), text.size());
+        text.clear();
+    }
+};
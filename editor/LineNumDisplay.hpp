@@ -1,8 +1,11 @@
 #pragma once
 
 #include "Component.hpp"
+#include "Trace.hpp"
 
-#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
 
 class LineNumDisplay :
     public Component {
@@ -13,32 +16,70 @@ public:
     ) :
         Component(left, top, width, height) {}
 
-public:
+private:
     size_t first_line_num = 0;
     size_t last_line_num = 0;
     size_t current_line_num = 0;
-    
+
+    // the lines after the last one are still being loaded
+    bool loading = false;
+
+    // what a row shows, and the commands which drew it
+    // a row is rendered again only when its number or its color changes
+    struct Row {
+        // 0 for the dots of loading
+        size_t line_num = 0;
+        bool is_current = false;
+        bool is_valid = false;
+        TerminalIO::Recording recording;
+    };
+    std::vector<Row> rows;
+    // the place of the component when the rows were recorded
+    SHORT rows_left = 0;
+    SHORT rows_top = 0;
+    SHORT rows_width = 0;
+
+public:
     COLOR background_color = COLOR::WHITE;
     COLOR font_color = COLOR::GRAY;
     COLOR current_line_font_color = COLOR::LIGHT_BLUE;
 
+    void set_lines(size_t first_line_num, size_t current_line_num, size_t last_line_num) {
+        if (this->first_line_num == first_line_num &&
+            this->current_line_num == current_line_num &&
+            this->last_line_num == last_line_num)
+            return;
+        this->first_line_num = first_line_num;
+        this->current_line_num = current_line_num;
+        this->last_line_num = last_line_num;
+        invalidate();
+    }
+
+    void set_loading(bool loading) {
+        if (this->loading != loading)
+            invalidate();
+        this->loading = loading;
+    }
+
 public:
     void render() {
+        TRACE_SCOPE(LINE_NUMBERS);
+        if (rows.size() != size_t(get_height()) ||
+            rows_left != get_left() || rows_top != get_top() || rows_width != get_width()) {
+            rows.assign(get_height(), Row());
+            rows_left = get_left();
+            rows_top = get_top();
+            rows_width = get_width();
+        }
+
         int i = 0;
         for (; i < last_line_num - first_line_num && i < get_height(); ++i) {
-            auto line_num = std::to_string(i + first_line_num);
-            line_num.insert(0, get_width() - line_num.size() - 2, ' ');
-            line_num += "  ";
-            io.draw_text_line(
-                line_num.begin(),
-                line_num.end(),
-                get_left(),
-                get_top() + i,
-                get_width(),
-                i + first_line_num == current_line_num ?
-                current_line_font_color : font_color,
-                background_color
-            );
+            auto line_num = i + first_line_num;
+            render_row(i, line_num, line_num == current_line_num);
+        }
+        if (loading && i < get_height()) {
+            render_row(i, 0, false);
+            ++i;
         }
         io.draw_rect(
             get_left(),
@@ -47,6 +88,39 @@ public:
             get_height() - i,
             background_color
         );
+        for (; i < get_height(); ++i)
+            rows[i].is_valid = false;
     }
-};
 
+private:
+    void render_row(int i, size_t line_num, bool is_current) {
+        auto& row = rows[i];
+        if (row.is_valid && row.line_num == line_num && row.is_current == is_current &&
+            io.replay(row.recording))
+            return;
+
+        // the number is right-aligned, two spaces before the text
+        char text[32];
+        int length;
+        if (line_num != 0)
+            length = std::snprintf(text, sizeof(text), "%*zu  ", int(get_width()) - 2, line_num);
+        else
+            length = std::snprintf(text, sizeof(text), "%*s", int(get_width()) - 2, "...");
+        length = std::min(length, int(sizeof(text)) - 1);
+
+        auto mark = io.begin_recording();
+        io.draw_text_line(
+            text,
+            text + length,
+            get_left(),
+            get_top() + i,
+            get_width(),
+            is_current ? current_line_font_color : font_color,
+            background_color
+        );
+        io.end_recording(mark, row.recording);
+        row.line_num = line_num;
+        row.is_current = is_current;
+        row.is_valid = true;
+    }
+};
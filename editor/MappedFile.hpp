@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "File.hpp"
+
+#include <string>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// read-only view of a whole file
+// the pages are loaded by the system on demand, nothing is copied
+class MappedFile {
+#ifdef _WIN32
+    HANDLE      hfile = INVALID_HANDLE_VALUE;
+    HANDLE      hmapping = NULL;
+#else
+    int         fd = -1;
+#endif
+    const char* data = nullptr;
+    size_t      size = 0;
+    bool        opened = false;
+
+public:
+    MappedFile(const std::wstring& file) {
+#ifdef _WIN32
+        hfile = CreateFileW(
+            file.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            NULL,
+            OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN,
+            NULL
+        );
+        if (hfile == INVALID_HANDLE_VALUE)
+            return;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(hfile, &file_size))
+            return;
+        size = size_t(file_size.QuadPart);
+
+        // an empty file can not be mapped
+        if (size == 0) {
+            opened = true;
+            return;
+        }
+
+        hmapping = CreateFileMappingW(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!hmapping)
+            return;
+        data = static_cast<const char*>(
+            MapViewOfFile(hmapping, FILE_MAP_READ, 0, 0, 0)
+        );
+        opened = data != nullptr;
+#else
+        fd = ::open(File::native_path(file).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0)
+            return;
+        size = size_t(file_stat.st_size);
+
+        if (size == 0) {
+            opened = true;
+            return;
+        }
+
+        auto view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+            return;
+        madvise(view, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(view);
+        opened = true;
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() {
+        return opened;
+    }
+    const char* get_data() {
+        return data;
+    }
+    size_t get_size() {
+        return size;
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (hmapping)
+            CloseHandle(hmapping);
+        if (hfile != INVALID_HANDLE_VALUE)
+            CloseHandle(hfile);
+#else
+        if (data)
+            munmap(const_cast<char*>(data), size);
+        if (fd >= 0)
+            ::close(fd);
+#endif
+    }
+};
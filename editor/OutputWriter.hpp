@@ -1,6 +1,19 @@
 #pragma once
 
-#include <Windows.h>
+#include "Platform.hpp"
+#include "UnicodeWidth.hpp"
+#include "FrameBuffer.hpp"
+#include "Trace.hpp"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 enum class COLOR {
     BLACK = 0,
@@ -22,53 +35,139 @@ enum class COLOR {
     WHITE = LIGHT_GRAY | FOREGROUND_INTENSITY
 };
 
+// the frames are drawn on the editor thread and written to the console
+// on a present thread of their own, so a slow console does not hold up
+// the input
+// render() hands the drawn frame over and goes on with the next one, a
+// frame which the present thread has not taken by the time the next one
+// is done is replaced by it
+// every frame carries its size, the present thread resizes the console
+// when the size of the frames changes
+// the screen is a template parameter, so the writes of the cells are
+// bound at compile time, it provides get_size, set_size, write,
+// write_sequence and end_frame
+template <typename Screen>
 class OutputWriter {
-    HANDLE      hstdout;
-    CHAR_INFO*  buffer = nullptr;
+    Screen      screen;
+    // the frame which the editor thread draws
+    FrameBuffer buffer;
     SHORT       window_width = 0;
     SHORT       window_height = 0;
     WORD        background_color = BACKGROUND_INTENSITY;
 
+    // guard the frame which waits for the present thread, the sequences
+    // which go out with it, and the state of the present thread
+    std::mutex present_mutex;
+    std::condition_variable present_condition;
+    FrameBuffer pending_buffer;
+    bool has_pending_frame = false;
+    std::string pending_sequences;
+    bool is_presenting = false;
+    bool stopping = false;
+
+    // owned by the present thread: the frame which it writes,
+    // and the cells which are on the console now
+    FrameBuffer presented_buffer;
+    FrameBuffer front_buffer;
+    std::string sequences;
+    // the front buffer does not match the console
+    bool repaint_all = true;
+    std::atomic<size_t> cells_written{ 0 };
+
+    // dirty runs which are closer than this are written as one
+    static constexpr SHORT MERGE_GAP = 8;
+
+    std::thread present_thread;
+
 public:
-    OutputWriter() :
-        hstdout(GetStdHandle(STD_OUTPUT_HANDLE)) {
+    OutputWriter() {
+#ifdef EDITOR_TRACE
+        // the trace is destroyed after the present thread has stopped
+        Trace::get_instance();
+#endif
         check_window_size();
-
-        // hide the cursor
-        CONSOLE_CURSOR_INFO cursor_info;
-        GetConsoleCursorInfo(hstdout, &cursor_info);
-        cursor_info.bVisible = false;
-        SetConsoleCursorInfo(hstdout, &cursor_info);
+        present_thread = std::thread(&OutputWriter::present_loop, this);
     }
 
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
     COORD get_window_size() {
         return { window_width, window_height };
     }
 
 private:
-    SHORT get_x(SHORT screen_x, SHORT y) {
-        SHORT x1 = 0;
-        for (SHORT width = 0; width < screen_x;) {
-            size_t i = y * window_width + x1++;
-            width += get_font_width(buffer[i].Char.UnicodeChar);
-        }
-        return x1;
-    }
+    // the frame is recorded as a list of commands, which render() draws
+    // row by row in one pass over the cells
+    // every command keeps the clip rectangle and the layer which were
+    // current when it was recorded, higher layers are drawn above lower
+    // ones and the commands of a layer in the order they were recorded
+    struct Command {
+        enum class Type : unsigned char {
+            TEXT,
+            FILL,
+            STYLE
+        } type;
+        // TEXT: fill the rest of the width with spaces
+        // FILL: clear the text under the rectangle
+        bool flag;
+        int layer;
+        // the columns [x, x + width) of the rows [top, bottom),
+        // the rows are clipped already
+        SHORT x;
+        SHORT width;
+        SHORT top;
+        SHORT bottom;
+        SHORT clip_left;
+        SHORT clip_right;
+        COLOR color;
+        COLOR background_color;
+        // TEXT: the chars in text_storage
+        size_t text_first;
+        size_t text_count;
+    };
 
-private:
-    struct RectArgs {
+    struct Clip {
         SHORT left;
         SHORT top;
-        SHORT width;
-        SHORT height;
-        COLOR background_color;
-        bool clear_the_text = true;
+        SHORT right;
+        SHORT bottom;
+        int layer;
     };
-    std::vector<RectArgs> rects{};
-    size_t rect_cnt = 0;
+
+    // the storage is kept between frames, so recording allocates nothing
+    // once the frames have reached their size
+    std::vector<Command> commands;
+    std::vector<wchar_t> text_storage;
+    std::vector<Clip> clips;
+
+    // the commands in drawing order, and the same grouped by the rows
+    // which they touch: row_commands[row_starts[y], row_starts[y + 1])
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> row_starts;
+    std::vector<uint32_t> row_ends;
+    std::vector<uint32_t> row_commands;
+
 public:
-    // delayed draw
-    // the rectangles must be drawn after all texts were drawn
+    // the commands until pop_clip() only draw inside the rectangle,
+    // which is also clipped to the enclosing one, and above the
+    // commands of the lower layers
+    void push_clip(SHORT left, SHORT top, SHORT width, SHORT height, int layer = 0) {
+        auto outer = get_clip();
+        clips.push_back({
+            std::max(left, outer.left),
+            std::max(top, outer.top),
+            std::min(SHORT(left + width), outer.right),
+            std::min(SHORT(top + height), outer.bottom),
+            layer
+        });
+    }
+
+    void pop_clip() {
+        if (!clips.empty())
+            clips.pop_back();
+    }
+
     void draw_rect(
         SHORT left,
         SHORT top,
@@ -77,50 +176,10 @@ public:
         COLOR background_color,
         bool clear_the_text = true
     ) {
-        if (rects.size() > rect_cnt) {
-            rects[rect_cnt] = {
-               left,top,width,height,
-               background_color,clear_the_text
-            };
-        }
-        else {
-            rects.push_back(
-                {
-                    left,top,width,height,
-                    background_color,clear_the_text
-                }
-            );
-        }
-        ++rect_cnt;
-    }
-
-private:
-    // called in render()
-    void draw_rect_impl() {
-        rect_cnt = 0;
-        for (auto& rect_args : rects) {
-            auto y1 = rect_args.top;
-            auto y2 = y1 + rect_args.height;
-            for (size_t y = y1; y < y2; ++y) {
-                auto x1 = get_x(rect_args.left, y);
-                auto x2 = x1 + rect_args.width;
-                if (x2 > window_width || y2 > window_height)
-                    return;
-                for (size_t x = x1; x < x2; ++x) {
-                    size_t i = y * window_width + x;
-                    if (i > window_height * window_width)
-                        return;
-                    buffer[i].Attributes &= 0xff0f;
-                    buffer[i].Attributes |= (static_cast<WORD>(rect_args.background_color) << 4);
-                    if (rect_args.clear_the_text)
-                        buffer[i].Char.UnicodeChar = ' ';
-                }
-            }
-        }
-        return;
+        record(Command::Type::FILL, clear_the_text, left, width, top, height,
+            COLOR::BLACK, background_color);
     }
 
-public:
     template <typename Iterator>
     void draw_text_line(
         Iterator first,
@@ -132,155 +191,410 @@ public:
         COLOR background_color,
         bool space_after_text = true
     ) {
-        SHORT written_width = 0;
-        size_t i = y * window_width + get_x(x, y);
-        size_t i0 = i;
-        auto it = first;
-        if (it != last)
-            written_width += get_font_width(*it);
-        for (; it != last && written_width <= width && i < window_height * window_width;) {
-            buffer[i].Attributes &= 0xff00;
-            buffer[i].Attributes |= static_cast<WORD>(color);
-            buffer[i].Attributes |= (static_cast<WORD>(background_color) << 4);
-            buffer[i].Char.UnicodeChar = *it;
-            ++it, ++i;
-            if (it != last)
-                written_width += get_font_width(*it);
+        auto text_first = text_storage.size();
+        if (!record(Command::Type::TEXT, space_after_text, x, width, y, 1,
+            color, background_color))
+            return;
+        for (; first != last; ++first)
+            text_storage.push_back(wchar_t(*first));
+        commands.back().text_first = text_first;
+        commands.back().text_count = text_storage.size() - text_first;
+    }
+
+    // the commands which a component recorded, kept to be drawn again
+    // while the component has not changed
+    class Recording {
+        friend class OutputWriter;
+        std::vector<Command> commands;
+        std::vector<wchar_t> text;
+        // the clips of the commands hold for this window size only
+        COORD window_size{ 0, 0 };
+    };
+
+    // where a recording starts in the commands of the frame,
+    // recordings can be nested
+    struct RecordingMark {
+        size_t command;
+        size_t text;
+    };
+
+    RecordingMark begin_recording() {
+        return { commands.size(), text_storage.size() };
+    }
+
+    // keep the commands recorded since the mark
+    void end_recording(const RecordingMark& mark, Recording& recording) {
+        recording.commands.assign(commands.begin() + mark.command, commands.end());
+        for (auto& command : recording.commands)
+            if (command.type == Command::Type::TEXT)
+                command.text_first -= mark.text;
+        recording.text.assign(text_storage.begin() + mark.text, text_storage.end());
+        recording.window_size = get_window_size();
+    }
+
+    // draw the recorded commands again,
+    // return false if the window has changed its size since
+    bool replay(const Recording& recording) {
+        if (recording.window_size.X != window_width || recording.window_size.Y != window_height)
+            return false;
+        auto text_first = text_storage.size();
+        text_storage.insert(text_storage.end(), recording.text.begin(), recording.text.end());
+        for (auto command : recording.commands) {
+            if (command.type == Command::Type::TEXT)
+                command.text_first += text_first;
+            commands.push_back(command);
         }
-        if (it != last)
-            written_width -= get_font_width(*it);
-        if (space_after_text)
-            while (written_width < width && i < window_height * window_width) {
-                buffer[i].Attributes &= 0xff0f;
-                buffer[i].Attributes |= (static_cast<WORD>(background_color) << 4);
-                buffer[i].Char.UnicodeChar = ' ';
-                ++i; ++written_width;
-            }
+        return true;
     }
 
+    // return false if the cell is clipped
     bool set_font_style(
         SHORT x,
         SHORT y,
         COLOR color,
         COLOR background_color
     ) {
-        size_t i = y * window_width + get_x(x, y);
-        if (i > window_height * window_width)
+        auto clip = get_clip();
+        if (x < clip.left || x >= clip.right)
+            return false;
+        return record(Command::Type::STYLE, false, x, 1, y, 1, color, background_color);
+    }
+
+private:
+    // the window is not a clip of its own, its size may change before
+    // the frame is drawn, rasterize() clips the commands to it
+    Clip get_clip() {
+        if (clips.empty())
+            return { 0, 0, SHRT_MAX, SHRT_MAX, 0 };
+        return clips.back();
+    }
+
+    bool record(
+        typename Command::Type type, bool flag,
+        SHORT x, SHORT width, SHORT top, SHORT height,
+        COLOR color, COLOR background_color
+    ) {
+        auto clip = get_clip();
+        auto first_row = std::max(top, clip.top);
+        auto last_row = std::min(SHORT(top + height), clip.bottom);
+        if (first_row >= last_row || width <= 0 || x >= clip.right || x + width <= clip.left)
             return false;
-        buffer[i].Attributes &= 0xff00;
-        buffer[i].Attributes |= static_cast<WORD>(color);
-        buffer[i].Attributes |= (static_cast<WORD>(background_color) << 4);
+        commands.push_back({
+            type, flag, clip.layer,
+            x, width, first_row, last_row,
+            clip.left, clip.right,
+            color, background_color,
+            0, 0
+        });
+        return true;
+    }
+
+    // draw the recorded commands into the buffer, one row after another
+    void rasterize() {
+        TRACE_SCOPE(COMPOSE);
+        for (auto& command : commands) {
+            command.bottom = std::min(command.bottom, window_height);
+            command.clip_right = std::min(command.clip_right, window_width);
+        }
+
+        order.resize(commands.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(),
+            [this](uint32_t a, uint32_t b) {
+                return commands[a].layer != commands[b].layer ?
+                    commands[a].layer < commands[b].layer : a < b;
+            }
+        );
+
+        row_starts.assign(window_height + 1, 0);
+        for (auto index : order)
+            for (auto y = commands[index].top; y < commands[index].bottom; ++y)
+                ++row_starts[y + 1];
+        for (SHORT y = 0; y < window_height; ++y)
+            row_starts[y + 1] += row_starts[y];
+        row_ends.assign(row_starts.begin(), row_starts.end() - 1);
+        row_commands.resize(row_starts.back());
+        for (auto index : order)
+            for (auto y = commands[index].top; y < commands[index].bottom; ++y)
+                row_commands[row_ends[y]++] = index;
+
+        for (SHORT y = 0; y < window_height; ++y) {
+            for (auto k = row_starts[y]; k < row_starts[y + 1]; ++k) {
+                auto& command = commands[row_commands[k]];
+                switch (command.type) {
+                case Command::Type::TEXT:
+                    paint_text(command, y);
+                    break;
+                case Command::Type::FILL:
+                    paint_fill(command, y);
+                    break;
+                case Command::Type::STYLE:
+                    paint_style(command, y);
+                    break;
+                }
+            }
+        }
+
+        commands.clear();
+        text_storage.clear();
+        clips.clear();
+    }
+
+    // a wide char which loses one of its cells leaves a space in the other
+    void split_wide_char(wchar_t* chars, SHORT x) {
+        if (chars[x] == CONTINUATION_CHAR) {
+            if (x > 0)
+                chars[x - 1] = ' ';
+        }
+        else if (x + 1 < window_width && chars[x + 1] == CONTINUATION_CHAR)
+            chars[x + 1] = ' ';
+    }
+
+    static WORD get_attributes(WORD attributes, COLOR color, COLOR background_color) {
+        return (attributes & 0xff00) |
+            static_cast<WORD>(color) |
+            (static_cast<WORD>(background_color) << 4);
+    }
+
+    // set the background of the columns [left, right) of the row y,
+    // and make them spaces if clear_the_text
+    void fill_row(SHORT y, SHORT left, SHORT right, COLOR background_color, bool clear_the_text) {
+        if (left >= right)
+            return;
+        if (clear_the_text) {
+            auto chars = buffer.get_chars(y);
+            split_wide_char(chars, left);
+            split_wide_char(chars, right - 1);
+            std::fill(chars + left, chars + right, L' ');
+        }
+        FrameBuffer::fill_background(buffer.get_attributes(y) + left, right - left,
+            static_cast<WORD>(background_color));
+    }
+
+    void paint_text(const Command& command, SHORT y) {
+        auto it = text_storage.begin() + command.text_first;
+        auto last = it + command.text_count;
+
+        // the chars left of the clip are not drawn
+        SHORT x = command.x;
+        while (x < command.clip_left && it != last)
+            x += get_font_width(*it++);
+        if (x < command.clip_left)
+            x = command.clip_left;
+        SHORT right = std::min(SHORT(command.x + command.width), command.clip_right);
+
+        auto chars = buffer.get_chars(y);
+        auto attributes = buffer.get_attributes(y);
+        for (; it != last; ++it) {
+            auto font_width = get_font_width(*it);
+            // combining marks take no cell of their own
+            if (font_width == 0)
+                continue;
+            if (x + font_width > right)
+                break;
+            auto attribute = get_attributes(attributes[x], command.color, command.background_color);
+            split_wide_char(chars, x);
+            // a zero char in the text would read as a continuation cell
+            chars[x] = *it == CONTINUATION_CHAR ? L' ' : *it;
+            attributes[x] = attribute;
+            if (font_width == 2) {
+                split_wide_char(chars, x + 1);
+                chars[x + 1] = CONTINUATION_CHAR;
+                attributes[x + 1] = attribute;
+            }
+            x += font_width;
+        }
+        if (command.flag)
+            fill_row(y, x, right, command.background_color, true);
+    }
+
+    void paint_fill(const Command& command, SHORT y) {
+        fill_row(y,
+            std::max(command.x, command.clip_left),
+            std::min(SHORT(command.x + command.width), command.clip_right),
+            command.background_color,
+            command.flag
+        );
+    }
+
+    void paint_style(const Command& command, SHORT y) {
+        if (command.x >= command.clip_right)
+            return;
+        auto& attribute = buffer.get_attributes(y)[command.x];
+        attribute = get_attributes(attribute, command.color, command.background_color);
     }
 
 public:
     static SHORT get_font_width(wchar_t ch) {
-        if (
-            // պֲײ
-            // 
-            // ַ
-            // պźͱ
-            // ƽ
-            // Ƭ
-            // ע
-            // ļĸ
-            // ѵ
-            // עչ
-            // պʻ
-            // Ƭչ
-            // պȦַ·
-            // պ
-            // պݱչA
-            // ׾64Է
-            // պͳһ
-            (0x2e80 <= ch && ch <= 0x9fff) ||
-
-            // 
-            // ĸչ
-            (0xac00 <= ch && ch <= 0xd7ff) ||
-
-            // պݱ
-            (0xf900 <= ch && ch <= 0xfaff) ||
-
-            // ʽ
-            (0xfe10 <= ch && ch <= 0xfe1f) ||
-
-            // պʽ
-            // Сͱʽ
-            (0xfe30 <= ch && ch <= 0xfe6f) ||
-
-            // ȫǷ
-            (0xff00 <= ch && ch <= 0xff60) ||
-
-            // ַšemoji
-            (0x1f300 <= ch && ch <= 0x1faff) ||
-
-            // պͳһչB~F
-            (0x20000 <= ch && ch <= 0x2fa1f)
-            )
-            return 2;
-
-        return 1;
+        return SHORT(UnicodeWidth::get(char32_t(ch)));
     }
 
 public:
     void render() {
-        draw_rect_impl();
-
-        for (SHORT y = 0; y < window_height; ++y) {
-            size_t i = y * window_width;
-            size_t j = i + window_width - 1;
-            while (j > i)
-                if (get_font_width(buffer[i++].Char.UnicodeChar) == 2)
-                    buffer[j--].Char.UnicodeChar = 0;
+        // the frame after a resize is drawn at the new size
+        check_window_size();
+        rasterize();
+        {
+            std::lock_guard<std::mutex> lock(present_mutex);
+            std::swap(buffer, pending_buffer);
+            has_pending_frame = true;
+            TRACE_FRAME_COMPOSED();
         }
+        present_condition.notify_all();
 
-        SMALL_RECT rect{ 0,0,window_width - 1, window_height - 1 };
-        WriteConsoleOutput(
-            hstdout,
-            buffer,
-            { window_width, window_height },
-            { 0,0 },
-            &rect
+        // the buffer which came back may hold a frame of another size
+        if (buffer.get_width() != window_width || buffer.get_height() != window_height)
+            buffer.resize(window_width, window_height);
+        flush();
+    }
+
+    // wait until the frames handed over have been written
+    void finish() {
+        std::unique_lock<std::mutex> lock(present_mutex);
+        present_condition.wait(lock,
+            [this] {
+                return !has_pending_frame && pending_sequences.empty() && !is_presenting;
+            }
         );
+    }
 
-        flush();
-        check_window_size();
+    // an escape sequence which neither moves the cursor nor changes the
+    // colors, it goes out with the next frame
+    void write_sequence(const std::string& sequence) {
+        {
+            std::lock_guard<std::mutex> lock(present_mutex);
+            pending_sequences += sequence;
+        }
+        present_condition.notify_all();
     }
 
-private:
-    void flush() {
-        for (size_t i = 0; i < window_width * window_height; ++i) {
-            buffer[i].Attributes &= 0xff0f;
-            buffer[i].Attributes |= (static_cast<WORD>(background_color) << 4);
-            buffer[i].Char.UnicodeChar = ' ';
+    // the screen can be read once finish() has returned
+    Screen& get_screen() {
+        return screen;
+    }
+
+    // the number of cells which the last frame wrote to the console,
+    // 0 when nothing had changed
+    size_t get_cells_written() {
+        return cells_written;
+    }
+
+    // the frames handed over are written before the thread ends
+    ~OutputWriter() {
+        {
+            std::lock_guard<std::mutex> lock(present_mutex);
+            stopping = true;
         }
+        present_condition.notify_all();
+        present_thread.join();
     }
 
-    void check_window_size() {
-        CONSOLE_SCREEN_BUFFER_INFO csbi_info;
-        GetConsoleScreenBufferInfo(hstdout, &csbi_info);
-        SHORT width = csbi_info.srWindow.Right - csbi_info.srWindow.Left + 1;
-        SHORT height = csbi_info.srWindow.Bottom - csbi_info.srWindow.Top + 1;
-        if (width != window_width || height != window_height) {
-            SetConsoleScreenBufferSize(
-                hstdout, { width, height }
+private:
+    void present_loop() {
+        std::unique_lock<std::mutex> lock(present_mutex);
+        while (true) {
+            present_condition.wait(lock,
+                [this] {
+                    return has_pending_frame || !pending_sequences.empty() || stopping;
+                }
             );
-            set_window_size(width, height);
+            bool has_frame = has_pending_frame;
+            if (has_frame) {
+                std::swap(pending_buffer, presented_buffer);
+                TRACE_FRAME_TAKEN();
+            }
+            has_pending_frame = false;
+            sequences.swap(pending_sequences);
+            if (!has_frame && sequences.empty())
+                break;
+            is_presenting = true;
+            lock.unlock();
+
+            if (!sequences.empty())
+                screen.write_sequence(sequences);
+            sequences.clear();
+            if (has_frame)
+                present();
+            {
+                TRACE_SCOPE(WRITE);
+                screen.end_frame();
+            }
+            if (has_frame)
+                TRACE_FRAME_PRESENTED();
+
+            lock.lock();
+            is_presenting = false;
+            present_condition.notify_all();
         }
     }
 
-    void set_window_size(SHORT window_width, SHORT window_height) {
-        this->window_width = window_width;
-        this->window_height = window_height;
-        if (buffer)
-            delete[]buffer;
-        buffer = new CHAR_INFO[window_height * (window_width)]{};
-        flush();
+    // write only the cells which differ from the front buffer
+    // a wide char is written with its continuation cell
+    void present() {
+        TRACE_SCOPE(PRESENT);
+        auto width = presented_buffer.get_width();
+        auto height = presented_buffer.get_height();
+        if (width != front_buffer.get_width() || height != front_buffer.get_height()) {
+            screen.set_size({ width, height });
+            front_buffer.resize(width, height);
+            repaint_all = true;
+        }
+
+        size_t written = 0;
+        for (SHORT y = 0; y < height; ++y) {
+            if (repaint_all) {
+                written += write_cells(0, width, y);
+                continue;
+            }
+            if (presented_buffer.is_same_row(front_buffer, y))
+                continue;
+
+            auto chars = presented_buffer.get_chars(y);
+            size_t row = size_t(y) * width;
+            SHORT x = 0;
+            while (true) {
+                while (x < width && presented_buffer.is_same_cell(front_buffer, row + x))
+                    ++x;
+                if (x == width)
+                    break;
+                SHORT first = x;
+                SHORT last = x + 1;
+                for (++x; x < width && x - last < MERGE_GAP; ++x)
+                    if (!presented_buffer.is_same_cell(front_buffer, row + x))
+                        last = x + 1;
+                if (first > 0 && chars[first] == CONTINUATION_CHAR)
+                    --first;
+                if (last < width && chars[last] == CONTINUATION_CHAR)
+                    ++last;
+                written += write_cells(first, last, y);
+                x = last;
+            }
+        }
+        cells_written = written;
+
+        front_buffer.copy_from(presented_buffer);
+        repaint_all = false;
     }
 
-public:
-    ~OutputWriter() {
-        delete[]buffer;
+    size_t write_cells(SHORT first, SHORT last, SHORT y) {
+        TRACE_SCOPE(WRITE);
+        screen.write(presented_buffer, first, last, y);
+        return last - first;
+    }
+
+    void flush() {
+        buffer.clear(background_color);
     }
-};
 
+    // the size is only read here, the present thread sets it
+    void check_window_size() {
+        auto size = screen.get_size();
+        if (size.X != window_width || size.Y != window_height) {
+            window_width = size.X;
+            window_height = size.Y;
+            buffer.resize(window_width, window_height);
+            flush();
+        }
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+// the editor is written against the win32 console types, key codes and
+// colors, on the other platforms the ones in use are defined here
+#ifdef _WIN32
+#include <Windows.h>
+#else
+using SHORT = short;
+using WORD = unsigned short;
+using DWORD = unsigned long;
+using BOOL = int;
+
+struct COORD {
+    SHORT X;
+    SHORT Y;
+};
+
+struct CHAR_INFO {
+    union {
+        wchar_t UnicodeChar;
+        char AsciiChar;
+    } Char;
+    WORD Attributes;
+};
+
+constexpr WORD FOREGROUND_BLUE = 0x0001;
+constexpr WORD FOREGROUND_GREEN = 0x0002;
+constexpr WORD FOREGROUND_RED = 0x0004;
+constexpr WORD FOREGROUND_INTENSITY = 0x0008;
+constexpr WORD BACKGROUND_BLUE = 0x0010;
+constexpr WORD BACKGROUND_GREEN = 0x0020;
+constexpr WORD BACKGROUND_RED = 0x0040;
+constexpr WORD BACKGROUND_INTENSITY = 0x0080;
+
+// virtual key codes
+constexpr WORD VK_BACK = 0x08;
+constexpr WORD VK_TAB = 0x09;
+constexpr WORD VK_RETURN = 0x0d;
+constexpr WORD VK_ESCAPE = 0x1b;
+constexpr WORD VK_PRIOR = 0x21;
+constexpr WORD VK_NEXT = 0x22;
+constexpr WORD VK_END = 0x23;
+constexpr WORD VK_HOME = 0x24;
+constexpr WORD VK_LEFT = 0x25;
+constexpr WORD VK_UP = 0x26;
+constexpr WORD VK_RIGHT = 0x27;
+constexpr WORD VK_DOWN = 0x28;
+constexpr WORD VK_DELETE = 0x2e;
+
+// control key states
+constexpr DWORD RIGHT_ALT_PRESSED = 0x0001;
+constexpr DWORD LEFT_ALT_PRESSED = 0x0002;
+constexpr DWORD RIGHT_CTRL_PRESSED = 0x0004;
+constexpr DWORD LEFT_CTRL_PRESSED = 0x0008;
+constexpr DWORD SHIFT_PRESSED = 0x0010;
+#endif
+
+// the frame buffers have one cell per screen column, a wide char is
+// followed by a continuation cell which holds this char
+constexpr wchar_t CONTINUATION_CHAR = 0;
+
+// the line breaks of a new file
+#ifdef _WIN32
+constexpr bool NATIVE_CRLF = true;
+#else
+constexpr bool NATIVE_CRLF = false;
+#endif
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define EDITOR_SSE2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// msvc accepts avx2 intrinsics in any function
+#define EDITOR_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define EDITOR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// cpu feature detection and small vectorized helpers
+// sse2 is assumed wherever it is enabled at compile time,
+// avx2 is selected at runtime
+class Simd {
+public:
+    static bool has_avx2() {
+        static const bool avx2 = detect_avx2();
+        return avx2;
+    }
+
+    static int count_trailing_zeros(uint32_t mask) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return int(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // the first ch in [first, last), or last
+    static const wchar_t* find(const wchar_t* first, const wchar_t* last, wchar_t ch) {
+#ifdef EDITOR_SSE2
+        constexpr size_t LANES = 16 / sizeof(wchar_t);
+        auto pattern = sizeof(wchar_t) == 2 ?
+            _mm_set1_epi16(short(ch)) : _mm_set1_epi32(int(ch));
+        for (; size_t(last - first) >= LANES; first += LANES) {
+            auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            auto equal = sizeof(wchar_t) == 2 ?
+                _mm_cmpeq_epi16(chars, pattern) : _mm_cmpeq_epi32(chars, pattern);
+            uint32_t mask = _mm_movemask_epi8(equal);
+            if (mask)
+                return first + count_trailing_zeros(mask) / sizeof(wchar_t);
+        }
+#endif
+        for (; first != last; ++first)
+            if (*first == ch)
+                return first;
+        return last;
+    }
+
+    // the number of chars below 0x80 at the beginning of [first, last)
+    static size_t ascii_length(const wchar_t* first, const wchar_t* last) {
+        auto begin = first;
+#ifdef EDITOR_SSE2
+        constexpr size_t LANES = 16 / sizeof(wchar_t);
+        auto non_ascii = sizeof(wchar_t) == 2 ?
+            _mm_set1_epi16(short(0xff80)) : _mm_set1_epi32(int(0xffffff80));
+        auto zero = _mm_setzero_si128();
+        for (; size_t(last - first) >= LANES; first += LANES) {
+            auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            auto ascii = _mm_cmpeq_epi8(_mm_and_si128(chars, non_ascii), zero);
+            uint32_t mask = ~_mm_movemask_epi8(ascii) & 0xffff;
+            if (mask)
+                return (first - begin) + count_trailing_zeros(mask) / sizeof(wchar_t);
+        }
+#endif
+        for (; first != last && *first < 0x80; ++first) {}
+        return first - begin;
+    }
+
+private:
+    static bool detect_avx2() {
+#ifdef EDITOR_SSE2
+        int info[4]{};
+        cpuid(info, 1, 0);
+        // the os must save the ymm registers
+        bool osxsave = info[2] & (1 << 27);
+        bool avx = info[2] & (1 << 28);
+        if (!osxsave || !avx || (xgetbv() & 0b110) != 0b110)
+            return false;
+        cpuid(info, 7, 0);
+        return info[1] & (1 << 5);
+#else
+        return false;
+#endif
+    }
+
+#ifdef EDITOR_SSE2
+    static void cpuid(int info[4], int leaf, int subleaf) {
+#ifdef _MSC_VER
+        __cpuidex(info, leaf, subleaf);
+#else
+        unsigned a, b, c, d;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        info[0] = int(a), info[1] = int(b), info[2] = int(c), info[3] = int(d);
+#endif
+    }
+
+    static uint64_t xgetbv() {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (uint64_t(edx) << 32) | eax;
+#endif
+    }
+#endif
+};
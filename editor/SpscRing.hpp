@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// a bounded queue between one producer thread and one consumer thread
+// neither side takes a lock: each owns one index and only reads the
+// other's, so a push or a pop is a load, a copy and a store
+// the indices run freely and are masked, so CAPACITY is a power of two
+template <typename T, size_t CAPACITY>
+class SpscRing {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+        "the capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value,
+        "the items are copied in and out of the slots");
+
+    // each side's index shares a cache line with the side's copy of the
+    // other index and with nothing else, so the two threads do not
+    // invalidate each other's line on every item
+    static constexpr size_t CACHE_LINE = 64;
+
+    // written by the consumer
+    alignas(CACHE_LINE) std::atomic<size_t> head{ 0 };
+    // the consumer's copy of tail, refreshed only when the ring looks empty
+    size_t cached_tail = 0;
+
+    // written by the producer
+    alignas(CACHE_LINE) std::atomic<size_t> tail{ 0 };
+    // the producer's copy of head, refreshed only when the ring looks full
+    size_t cached_head = 0;
+
+    alignas(CACHE_LINE) T items[CAPACITY];
+
+public:
+    SpscRing() {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // called by the producer, return false if the ring is full
+    bool push(const T& item) {
+        auto t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == CAPACITY) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t - cached_head == CAPACITY)
+                return false;
+        }
+        items[t & (CAPACITY - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // called by the consumer, return false if the ring is empty
+    bool pop(T& item) {
+        auto h = head.load(std::memory_order_relaxed);
+        if (h == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (h == cached_tail)
+                return false;
+        }
+        item = items[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // may be called by either side, the answer can be stale at once
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
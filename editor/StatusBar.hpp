@@ -13,19 +13,39 @@ public:
     ) :
         Component(left, top, width, 1) {}
 
-public:
+private:
     int line = 1;
     int character = 1;
 
+    // shown after the position
+    std::wstring message;
+
+public:
     COLOR font_color = COLOR::WHITE;
     COLOR background_color = COLOR::CYAN;
 
+    void set_position(int line, int character) {
+        if (this->line == line && this->character == character)
+            return;
+        this->line = line;
+        this->character = character;
+        invalidate();
+    }
+
+    void set_message(const std::wstring& message) {
+        if (this->message == message)
+            return;
+        this->message = message;
+        invalidate();
+    }
+
     void render() {
         std::wstring position = L"            ";
         auto col = std::to_wstring(line);
         auto row = std::to_wstring(character);
         position.replace(4, col.size(), col.c_str());
         position.replace(11, row.size(), row.c_str());
+        position += message;
         io.draw_text_line(
             position.begin(),
             position.end(),
@@ -1,26 +1,65 @@
 #pragma once
 
-#include "InputListener.hpp"
 #include "OutputWriter.hpp"
+#include "Utf8.hpp"
+#ifdef EDITOR_HEADLESS
+#include "HeadlessInput.hpp"
+#include "HeadlessScreen.hpp"
+#else
+#include "InputListener.hpp"
+#ifdef _WIN32
+#include "ConsoleScreen.hpp"
+#else
+#include "VtScreen.hpp"
+#endif
+#endif
 #include <string>
 
-class TerminalIO:
-    public InputListener,
-    public OutputWriter {
-    TerminalIO() :
-        InputListener(),
-        OutputWriter() {}
+// a backend is an input and a screen which work together
+#ifdef EDITOR_HEADLESS
+// runs without a console, for scripted sessions and benchmarks
+struct HeadlessBackend {
+    using Input = HeadlessInput;
+    using Screen = HeadlessScreen;
+};
+#elif defined(_WIN32)
+struct ConsoleBackend {
+    using Input = InputListener;
+    using Screen = ConsoleScreen;
+};
+#else
+struct VtBackend {
+    using Input = InputListener;
+    using Screen = VtScreen;
+};
+#endif
+
+// the backend is chosen at compile time, nothing on the way from the
+// components to the screen is virtual
+template <typename Backend>
+class BasicTerminalIO:
+    public Backend::Input,
+    public OutputWriter<typename Backend::Screen> {
+    using Input = typename Backend::Input;
+    using Output = OutputWriter<typename Backend::Screen>;
+
+    BasicTerminalIO() :
+        Input(),
+        Output() {}
 public:
-    static TerminalIO& get_instance() {
-        static TerminalIO instance;
+    using typename Input::WINDOW_SIZE_CALLBACK;
+
+    static BasicTerminalIO& get_instance() {
+        static BasicTerminalIO instance;
         return instance;
     }
     void set_window_size_callback(WINDOW_SIZE_CALLBACK callback) {
-        auto window_size = get_window_size();
+        auto window_size = this->get_window_size();
         callback(window_size.X, window_size.Y);
-        InputListener::set_window_size_callback(callback);
+        Input::set_window_size_callback(callback);
     }
 
+#ifdef _WIN32
     bool write_clipboard(const std::wstring& text){
         if (!OpenClipboard(NULL))
             return false;
@@ -48,10 +87,81 @@ public:
         );
         GlobalUnlock(hmem);
         
+        // the memory belongs to the system once it is set
         bool res = SetClipboardData(CF_UNICODETEXT, hmem);
         CloseClipboard();
-        GlobalFree(hmem);
+        if (!res)
+            GlobalFree(hmem);
         return res;
     }
+
+    // changes whenever any program writes the clipboard
+    size_t get_clipboard_version() {
+        return GetClipboardSequenceNumber();
+    }
+
+    bool read_clipboard(std::wstring& text) {
+        if (!OpenClipboard(NULL))
+            return false;
+        HANDLE hmem = GetClipboardData(CF_UNICODETEXT);
+        auto data = hmem ? (const wchar_t*)GlobalLock(hmem) : nullptr;
+        if (!data) {
+            CloseClipboard();
+            return false;
+        }
+        text = data;
+        GlobalUnlock(hmem);
+        CloseClipboard();
+        return true;
+    }
+#else
+    // the terminal sets the clipboard on OSC 52 with the text in base64
+    bool write_clipboard(const std::wstring& text) {
+        static constexpr char DIGITS[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string bytes;
+        char encoded[4];
+        for (auto ch : text)
+            bytes.append(encoded, Utf8::encode(uint32_t(ch), encoded));
+
+        std::string sequence = "\x1b]52;c;";
+        for (size_t i = 0; i < bytes.size(); i += 3) {
+            uint32_t group = uint32_t(uint8_t(bytes[i])) << 16;
+            if (i + 1 < bytes.size())
+                group |= uint32_t(uint8_t(bytes[i + 1])) << 8;
+            if (i + 2 < bytes.size())
+                group |= uint8_t(bytes[i + 2]);
+            sequence += DIGITS[(group >> 18) & 63];
+            sequence += DIGITS[(group >> 12) & 63];
+            sequence += i + 1 < bytes.size() ? DIGITS[(group >> 6) & 63] : '=';
+            sequence += i + 2 < bytes.size() ? DIGITS[group & 63] : '=';
+        }
+        sequence += '\a';
+
+        // the frames are written on another thread, the sequence goes
+        // out between two of them
+        this->write_sequence(sequence);
+        return true;
+    }
+
+    // the terminals do not let the clipboard be read,
+    // what is pasted there arrives as input
+    size_t get_clipboard_version() {
+        return 0;
+    }
+
+    bool read_clipboard(std::wstring&) {
+        return false;
+    }
+#endif
 };
 
+#ifdef EDITOR_HEADLESS
+using TerminalIO = BasicTerminalIO<HeadlessBackend>;
+#elif defined(_WIN32)
+using TerminalIO = BasicTerminalIO<ConsoleBackend>;
+#else
+using TerminalIO = BasicTerminalIO<VtBackend>;
+#endif
+
@@ -2,10 +2,16 @@
 
 #include "Component.hpp"
 #include "Cursor.hpp"
+#include "Document.hpp"
+#include "UndoHistory.hpp"
+#include "ColumnIndex.hpp"
+#include "Clipboard.hpp"
+#include "Utf8.hpp"
+#include "Trace.hpp"
 
 #include <vector>
-#include <list>
 #include <string>
+#include <algorithm>
 
 class TextArea :
     public Component {
@@ -15,31 +21,19 @@ public:
         SHORT width, SHORT height
     ) :
         Component(left, top, width, height),
-        text({ Line() }),
-        cursor_pos{
-            0,0,
-            text.begin()
-        },
-        vice_cursor_pos{
-            0,0,
-            text.begin()
-        },
-        first_line_it(text.begin()),
+        cursor_pos{ 0,0 },
+        vice_cursor_pos{ 0,0 },
         cursor(left, top) {
         cursor.off_background_color = background_color;
         cursor.off_font_color = text_color;
     }
 
 private:
-    using Char = wchar_t;
-    using Line = std::vector<Char>;
-    using Text = std::list<Line>;
+    using Char = Document::Char;
     struct CursorPos {
         size_t char_index;
         size_t line_index;
 
-        Text::iterator line_it;
-
         // record the rightmost position of cursor
         // when moving up and downwards
         size_t          rightmost_cursor_pos = 0;
@@ -53,7 +47,9 @@ private:
         }
     };
 
-    Text            text;
+    Document        text;
+    UndoHistory     history;
+    ColumnIndex     columns{ text };
     CursorPos       cursor_pos;
     Cursor          cursor;
 
@@ -61,23 +57,65 @@ private:
     CursorPos       vice_cursor_pos;
 
     size_t          first_line = 0;
-    Text::iterator  first_line_it;
     int           horizontal_shift = 0;
-    size_t get_first_char(Text::iterator it, bool* need_not_display = nullptr) {
-        int width = 0;
-        size_t first_char = 0;
-        while (width < horizontal_shift && first_char < it->size())
-            width += TerminalIO::get_font_width((*it)[first_char++]);
-        if (width < horizontal_shift && need_not_display)
+    size_t get_first_char(size_t line_index, bool* need_not_display = nullptr) {
+        auto first_char = columns.char_at(line_index, horizontal_shift);
+        if (need_not_display && columns.column_of(line_index, first_char) < size_t(horizontal_shift))
             *need_not_display = true;
         return first_char;
     }
 
+    // the display width of the chars [first_char, last_char) in the line
+    int get_text_width(size_t line_index, size_t first_char, size_t last_char) {
+        if (last_char <= first_char)
+            return 0;
+        return int(
+            columns.column_of(line_index, last_char) -
+            columns.column_of(line_index, first_char)
+        );
+    }
+
+    size_t get_offset(const CursorPos& pos) {
+        return text.line_start(pos.line_index) + pos.char_index;
+    }
+
+    void set_offset(CursorPos& pos, size_t offset) {
+        pos.line_index = text.line_of(offset);
+        pos.char_index = offset - text.line_start(pos.line_index);
+        pos.rightmost_cursor_pos = 0;
+    }
+
+    // scratch space for the visible part of a line
+    std::vector<Char> line_buffer;
+    const std::vector<Char>& read_line(size_t line_index, size_t first_char, size_t last_char) {
+        line_buffer.clear();
+        if (last_char > first_char)
+            text.copy(
+                text.line_start(line_index) + first_char,
+                last_char - first_char,
+                std::back_inserter(line_buffer)
+            );
+        return line_buffer;
+    }
+
     bool is_active = true;
+    bool is_read_only = false;
 public:
     void set_active(bool active){
+        if (is_active != active)
+            invalidate();
         is_active = active;
     }
+    // the text area must be rendered again by then for the cursor to blink
+    Cursor::Clock::time_point get_deadline() {
+        if (is_active && !is_selecting)
+            return cursor.get_deadline();
+        return Cursor::Clock::time_point::max();
+    }
+    // the cursor can still move and select
+    void set_read_only(bool read_only) {
+        is_read_only = read_only;
+    }
 
 private:
     COLOR text_color = COLOR::BLACK;
@@ -87,23 +125,27 @@ private:
 
 public:
     void set_text_color(COLOR color) {
+        invalidate();
         text_color = color;
         cursor.off_font_color = color;
     }
     void set_background_color(COLOR color) {
+        invalidate();
         background_color = color;
         cursor.off_background_color = color;
     }
     void set_selected_text_color(COLOR color) {
+        invalidate();
         selected_text_color = color;
     }
     void set_selected_background_color(COLOR color) {
+        invalidate();
         selected_background_color = color;
     }
 
 public:
     size_t get_line_count(){
-        return text.size();
+        return text.line_count();
     }
     size_t get_first_line() {
         return first_line;
@@ -121,50 +163,82 @@ public:
             cursor_pos.char_index;
     }
 
+    // move the cursor as a jump to a line would, the position is clamped
+    // to the text and the selection is dropped
+    void set_cursor_pos(size_t line_index, size_t char_index) {
+        history.close_group();
+        is_selecting = false;
+        cursor_pos.line_index = std::min(line_index, text.line_count() - 1);
+        cursor_pos.char_index = std::min(char_index, text.line_length(cursor_pos.line_index));
+        cursor_pos.rightmost_cursor_pos = 0;
+        cursor.should_be_on();
+        check_cursor_pos(cursor_pos);
+        invalidate();
+    }
+
 private:
-    void insert(Char ch) {
-        auto& line = *cursor_pos.line_it;
-
-        if (ch == '\r' || ch == '\n') {
-            Line new_line(line.begin() + cursor_pos.char_index, line.end());
-            line.erase(line.begin() + cursor_pos.char_index, line.end());
-            ++cursor_pos.line_it;
-            cursor_pos.line_it =
-                text.insert(cursor_pos.line_it, std::move(new_line));
-            ++cursor_pos.line_index;
-            cursor_pos.char_index = 0;
-        }
-        else if (ch == '\t') {
-            insert(' ');
-            insert(' ');
-            insert(' ');
-            insert(' ');
-        }
-        else if (ch == '\b') {
-            backspace();
-        }
-        else {
-            line.insert(cursor_pos.line_it->begin() + cursor_pos.char_index, ch);
-            ++cursor_pos.char_index;
+    // scratch space for the text being inserted
+    std::vector<Char> insert_buffer;
+
+    // type the chars at the cursor: the text between the backspaces is
+    // inserted in one piece, and the cursor and the view are updated once
+    void insert_text(const Char* chars, size_t count) {
+        insert_buffer.clear();
+        bool has_line_feed = false;
+        for (size_t i = 0; i < count; ++i) {
+            auto ch = chars[i];
+            if (ch == '\r' || ch == '\n') {
+                insert_buffer.push_back('\n');
+                has_line_feed = true;
+            }
+            else if (ch == '\t')
+                insert_buffer.insert(insert_buffer.end(), 4, ' ');
+            else if (ch == '\b') {
+                insert_run(has_line_feed);
+                has_line_feed = false;
+                backspace();
+            }
+            else
+                insert_buffer.push_back(ch);
         }
+        insert_run(has_line_feed);
 
         check_cursor_pos(cursor_pos);
         cursor.should_be_on();
     }
 
+    void insert_run(bool has_line_feed) {
+        if (insert_buffer.empty())
+            return;
+        auto offset = get_offset(cursor_pos);
+        history.insert(text, offset, insert_buffer.data(), insert_buffer.size(), offset);
+        if (has_line_feed) {
+            // text with line breaks is undone on its own
+            history.close_group();
+            columns.clear();
+            set_offset(cursor_pos, offset + insert_buffer.size());
+        }
+        else {
+            columns.invalidate(cursor_pos.line_index, cursor_pos.char_index);
+            cursor_pos.char_index += insert_buffer.size();
+        }
+        insert_buffer.clear();
+    }
+
     void backspace() {
+        auto offset = get_offset(cursor_pos);
         if (cursor_pos.char_index == 0) {
             if (cursor_pos.line_index > 0) {
-                auto to_del = cursor_pos.line_it--;
                 --cursor_pos.line_index;
-                cursor_pos.char_index = cursor_pos.line_it->size();
-                cursor_pos.line_it->insert(cursor_pos.line_it->end(), to_del->begin(), to_del->end());
-                text.erase(to_del);
+                cursor_pos.char_index = text.line_length(cursor_pos.line_index);
+                history.erase(text, offset - 1, 1, offset);
+                columns.clear();
             }
         }
         else {
-            cursor_pos.line_it->erase(cursor_pos.line_it->begin() + cursor_pos.char_index - 1);
             --cursor_pos.char_index;
+            history.erase(text, offset - 1, 1, offset);
+            columns.invalidate(cursor_pos.line_index, cursor_pos.char_index);
         }
 
         check_cursor_pos(cursor_pos);
@@ -175,31 +249,19 @@ private:
         const CursorPos& first,
         const CursorPos& last
     ) {
-        if (first.line_index == last.line_index) {
-            first.line_it->erase(
-                first.line_it->begin() + first.char_index, 
-                first.line_it->begin() + last.char_index
-            );
-            cursor_pos.char_index = first.char_index;
-        }
-        else {
-            last.line_it->erase(
-                last.line_it->begin(),
-                last.line_it->begin() + last.char_index
-            );
-            last.line_it->insert(
-                last.line_it->begin(),
-                first.line_it->begin(),
-                first.line_it->begin() + first.char_index
-            );
-            text.erase(
-                first.line_it, last.line_it
-            );
-            cursor_pos.line_it = last.line_it;
-            cursor_pos.line_index = first.line_index;
-            cursor_pos.char_index = first.char_index;
+        auto first_offset = get_offset(first);
+        history.erase(
+            text, first_offset, get_offset(last) - first_offset,
+            get_offset(is_selecting ? vice_cursor_pos : cursor_pos)
+        );
+        if (first.line_index != last.line_index) {
             cursor_pos.rightmost_cursor_pos = 0;
+            columns.clear();
         }
+        else
+            columns.invalidate(first.line_index, first.char_index);
+        cursor_pos.line_index = first.line_index;
+        cursor_pos.char_index = first.char_index;
 
         check_cursor_pos(cursor_pos);
     }
@@ -213,38 +275,16 @@ private:
         );
     }
 
-    std::wstring get_wstring_range(
+    Document::Snapshot get_range(
         const CursorPos& first,
         const CursorPos& last
     ) {
-        std::wstring wstr;
-        if (first.line_index == last.line_index) {
-            wstr.append(
-                first.line_it->begin() + first.char_index,
-                first.line_it->begin() + last.char_index
-            );
-        }
-        else {
-            wstr.append(
-                first.line_it->begin() + first.char_index,
-                first.line_it->end()
-            );
-            wstr += '\n';
-            auto it = first.line_it;
-            for (++it; it != last.line_it; ++it) {
-                wstr.append(it->begin(), it->end());
-                wstr += '\n';
-            }
-            wstr.append(
-                last.line_it->begin(),
-                last.line_it->begin() + last.char_index
-            );
-        }
-        return wstr;
+        auto first_offset = get_offset(first);
+        return text.snapshot(first_offset, get_offset(last) - first_offset);
     }
 
-    std::wstring get_selected() {
-        return get_wstring_range(
+    Document::Snapshot get_selected() {
+        return get_range(
             cursor_pos > vice_cursor_pos ?
             vice_cursor_pos : cursor_pos,
             cursor_pos > vice_cursor_pos ?
@@ -252,6 +292,58 @@ private:
         );
     }
 
+    void paste() {
+        auto& snapshot = Clipboard::get_instance().paste();
+        if (snapshot.size() == 0)
+            return;
+        if (is_selecting) {
+            // replacing the selection is undone at once
+            history.begin_group();
+            delete_selected();
+            is_selecting = false;
+            insert_snapshot(snapshot);
+            history.end_group();
+        }
+        else {
+            history.close_group();
+            insert_snapshot(snapshot);
+        }
+    }
+
+    // the pieces of the snapshot are spliced in, no chars are copied
+    void insert_snapshot(const Document::Snapshot& snapshot) {
+        auto offset = get_offset(cursor_pos);
+        history.insert(text, offset, snapshot, offset);
+        // a paste is undone on its own
+        history.close_group();
+        columns.clear();
+        set_offset(cursor_pos, offset + snapshot.size());
+        check_cursor_pos(cursor_pos);
+        cursor.should_be_on();
+    }
+
+    void undo() {
+        size_t offset;
+        if (history.undo(text, offset)) {
+            columns.clear();
+            is_selecting = false;
+            set_offset(cursor_pos, offset);
+            check_cursor_pos(cursor_pos);
+            cursor.should_be_on();
+        }
+    }
+
+    void redo() {
+        size_t offset;
+        if (history.redo(text, offset)) {
+            columns.clear();
+            is_selecting = false;
+            set_offset(cursor_pos, offset);
+            check_cursor_pos(cursor_pos);
+            cursor.should_be_on();
+        }
+    }
+
     void check_cursor_pos(CursorPos& cursor_pos) {
         if (cursor_pos.line_index >= first_line + get_height()) 
             first_line = cursor_pos.line_index - get_height() + 1;
@@ -259,99 +351,107 @@ private:
         else if (cursor_pos.line_index < first_line) 
             first_line = cursor_pos.line_index;
 
-        first_line_it = text.begin();
-        for (size_t i = 0; i < first_line; ++i)
-            ++first_line_it;
-
-        int width = 0;
-        auto first_char = get_first_char(cursor_pos.line_it);
-        for (size_t i = first_char; i < cursor_pos.char_index; ++i)
-            width += TerminalIO::get_font_width((*cursor_pos.line_it)[i]);
+        auto first_char = get_first_char(cursor_pos.line_index);
+        int width = get_text_width(cursor_pos.line_index, first_char, cursor_pos.char_index);
         if (width > get_width() - 1) {
             horizontal_shift += width - get_width() + 1;
             return;
         }
 
-        width = 0;
-        for (size_t i = 0; i < cursor_pos.char_index; ++i)
-            width += TerminalIO::get_font_width((*cursor_pos.line_it)[i]);
+        width = get_text_width(cursor_pos.line_index, 0, cursor_pos.char_index);
         if (width < horizontal_shift)
             horizontal_shift = width;
     }
 
     void move_cursor_left(CursorPos& cursor_pos) {
+        history.close_group();
         cursor_pos.rightmost_cursor_pos = 0;
         if (cursor_pos.char_index > 0) {
             --cursor_pos.char_index;
         }
         else if (cursor_pos.line_index > 0) {
             --cursor_pos.line_index;
-            --cursor_pos.line_it;
-            cursor_pos.char_index = cursor_pos.line_it->size();
+            cursor_pos.char_index = text.line_length(cursor_pos.line_index);
         }
         cursor.should_be_on();
         check_cursor_pos(cursor_pos);
     }
     void move_cursor_right(CursorPos& cursor_pos) {
+        history.close_group();
         cursor_pos.rightmost_cursor_pos = 0;
-        if (cursor_pos.char_index < cursor_pos.line_it->size()) {
+        if (cursor_pos.char_index < text.line_length(cursor_pos.line_index)) {
             ++cursor_pos.char_index;
         }
-        else if (cursor_pos.line_index != text.size() - 1) {
+        else if (cursor_pos.line_index != text.line_count() - 1) {
             ++cursor_pos.line_index;
-            ++cursor_pos.line_it;
             cursor_pos.char_index = 0;
         }
         cursor.should_be_on();
         check_cursor_pos(cursor_pos);
     }
     void move_cursor_up(CursorPos& cursor_pos) {
+        history.close_group();
         if (cursor_pos.char_index > cursor_pos.rightmost_cursor_pos)
             cursor_pos.rightmost_cursor_pos = cursor_pos.char_index;
         if (cursor_pos.line_index > 0) {
             --cursor_pos.line_index;
-            --cursor_pos.line_it;
+            auto line_length = text.line_length(cursor_pos.line_index);
             cursor_pos.char_index =
-                cursor_pos.rightmost_cursor_pos < cursor_pos.line_it->size() ?
-                cursor_pos.rightmost_cursor_pos : cursor_pos.line_it->size();
+                cursor_pos.rightmost_cursor_pos < line_length ?
+                cursor_pos.rightmost_cursor_pos : line_length;
         }
         cursor.should_be_on();
         check_cursor_pos(cursor_pos);
     }
     void move_cursor_down(CursorPos& cursor_pos) {
+        history.close_group();
         if (cursor_pos.char_index > cursor_pos.rightmost_cursor_pos)
             cursor_pos.rightmost_cursor_pos = cursor_pos.char_index;
-        if (cursor_pos.line_index != text.size() - 1) {
+        if (cursor_pos.line_index != text.line_count() - 1) {
             ++cursor_pos.line_index;
-            ++cursor_pos.line_it;
+            auto line_length = text.line_length(cursor_pos.line_index);
             cursor_pos.char_index =
-                cursor_pos.rightmost_cursor_pos < cursor_pos.line_it->size() ?
-                cursor_pos.rightmost_cursor_pos : cursor_pos.line_it->size();
+                cursor_pos.rightmost_cursor_pos < line_length ?
+                cursor_pos.rightmost_cursor_pos : line_length;
         }
         else {
-            cursor_pos.line_index = text.size() - 1;
-            cursor_pos.line_it = --text.end();
-            cursor_pos.char_index = cursor_pos.line_it->size();
+            cursor_pos.line_index = text.line_count() - 1;
+            cursor_pos.char_index = text.line_length(cursor_pos.line_index);
         }
         cursor.should_be_on();
         check_cursor_pos(cursor_pos);
     }
 
+protected:
+    void update() {
+        if (is_active && !is_selecting && Cursor::Clock::now() >= cursor.get_deadline())
+            invalidate();
+    }
+
 public:
     void render() {
-        auto it = first_line_it;
+        TRACE_SCOPE(TEXT_AREA);
+        auto line_count = text.line_count();
+        auto line_index = first_line;
         SHORT y = get_top();
-        for (; y < get_top() + get_height() && it != text.end(); ++y, ++it) {
-            auto first_char = get_first_char(it);
-            if (it->end() - it->begin() >= long long(first_char))
+        for (; y < get_top() + get_height() && line_index < line_count; ++y, ++line_index) {
+            auto first_char = get_first_char(line_index);
+            auto line_length = text.line_length(line_index);
+            if (line_length >= first_char) {
+                // no more than get_width() chars can be displayed
+                auto& chars = read_line(
+                    line_index, first_char,
+                    std::min(line_length, first_char + get_width() + 1)
+                );
                 io.draw_text_line(
-                    it->begin() + first_char,
-                    it->end(),
+                    chars.begin(),
+                    chars.end(),
                     get_left(), y,
                     get_width(),
                     text_color,
                     background_color
                 );
+            }
         }
         io.draw_rect(
             get_left(), y,
@@ -370,22 +470,20 @@ public:
 
             auto draw_selecting_text = [this](
                 size_t line_index,
-                Text::iterator line_it,
                 size_t left_char,
                 size_t right_char, 
                 bool space_after_text = false
                 ) {
                     bool need_not_display = false;
-                    auto first_char = get_first_char(line_it, &need_not_display);
+                    auto first_char = get_first_char(line_index, &need_not_display);
                     if (need_not_display) return;
                     
-                    int width_before = 0;
-                    int width = 0;
-                    size_t i = first_char;
-                    for (; i < left_char; ++i)
-                        width_before += io.get_font_width((*line_it)[i]);
-                    for (; i < right_char; ++i)
-                        width += io.get_font_width((*line_it)[i]);
+                    int width_before = get_text_width(line_index, first_char, left_char);
+                    int width = get_text_width(
+                        line_index,
+                        left_char > first_char ? left_char : first_char,
+                        right_char
+                    );
                     if (right_char >= first_char)
                         width++;
                     if (width > get_width() - width_before) width = get_width() - width_before;
@@ -393,10 +491,14 @@ public:
                     if (left_char > first_char)
                         first_char = left_char;
 
-                    if (right_char >= first_char)
+                    if (right_char >= first_char) {
+                        auto& chars = read_line(
+                            line_index, first_char,
+                            std::min(right_char, first_char + get_width() + 1)
+                        );
                         io.draw_text_line(
-                            line_it->begin() + first_char,
-                            line_it->begin() + right_char,
+                            chars.begin(),
+                            chars.end(),
                             get_left() + width_before,
                             get_top() + int(line_index) - int(first_line),
                             width,
@@ -404,46 +506,47 @@ public:
                             selected_background_color,
                             space_after_text
                         );
+                    }
             };
 
             if (left_cursor_pos.line_index == right_cursor_pos.line_index) {
                 if (left_cursor_pos.line_index >= first_line &&
                     int(left_cursor_pos.line_index) - int(first_line) < get_height())
                     draw_selecting_text(
-                        left_cursor_pos.line_index, left_cursor_pos.line_it,
+                        left_cursor_pos.line_index,
                         left_cursor_pos.char_index, right_cursor_pos.char_index
                     );
             }
             else {
                 if (left_cursor_pos.line_index >= first_line)
                     draw_selecting_text(
-                        left_cursor_pos.line_index, left_cursor_pos.line_it,
-                        left_cursor_pos.char_index, left_cursor_pos.line_it->size(),
+                        left_cursor_pos.line_index,
+                        left_cursor_pos.char_index, text.line_length(left_cursor_pos.line_index),
                         true
                     );
-                auto line_it = left_cursor_pos.line_it;
-                ++line_it;
                 for (size_t line_index = left_cursor_pos.line_index + 1;
                     line_index < right_cursor_pos.line_index && 
-                    int(line_index) - int(first_line) < get_height(); ++line_index, ++line_it)
+                    int(line_index) - int(first_line) < get_height(); ++line_index)
                     if (line_index >= first_line)
                         draw_selecting_text(
-                            line_index, line_it,
-                            get_first_char(line_it), line_it->size(),
+                            line_index,
+                            get_first_char(line_index), text.line_length(line_index),
                             true
                         );
                 if (int(right_cursor_pos.line_index) - int(first_line) < get_height())
                     draw_selecting_text(
-                        right_cursor_pos.line_index, right_cursor_pos.line_it,
-                        get_first_char(right_cursor_pos.line_it), right_cursor_pos.char_index
+                        right_cursor_pos.line_index,
+                        get_first_char(right_cursor_pos.line_index), right_cursor_pos.char_index
                     );
             }
         }
 
         if (is_active && !is_selecting) {
-            int rx = 0;
-            for (size_t i = get_first_char(cursor_pos.line_it); i < cursor_pos.char_index; ++i)
-                rx += TerminalIO::get_font_width((*cursor_pos.line_it)[i]);
+            int rx = get_text_width(
+                cursor_pos.line_index,
+                get_first_char(cursor_pos.line_index),
+                cursor_pos.char_index
+            );
             cursor.set_left(rx);
             cursor.set_top(int(cursor_pos.line_index) - int(first_line));
             cursor.render_relative(get_left(), get_top());
@@ -451,8 +554,15 @@ public:
     }
 
     void process_char(wchar_t ch) {
-        if (is_active) {
+        process_text(&ch, 1);
+    }
+
+    void process_text(const wchar_t* chars, size_t count) {
+        if (is_active && !is_read_only && count > 0) {
+            invalidate();
             if (is_selecting) {
+                // replacing the selection is undone at once
+                history.begin_group();
                 delete_range(
                     cursor_pos > vice_cursor_pos ?
                     vice_cursor_pos : cursor_pos,
@@ -460,16 +570,21 @@ public:
                     cursor_pos : vice_cursor_pos
                 );
                 is_selecting = false;
+                insert_text(chars, count);
+                history.end_group();
             }
-            insert(ch);
+            else insert_text(chars, count);
         }
     }
 
     void process_keydown(WORD vk_code, DWORD control_key_state) {
         if (is_active) {
+            invalidate();
             switch (vk_code) {
             // backspace
             case VK_BACK:
+                if (is_read_only)
+                    break;
                 if (!is_selecting)
                     backspace();
                 else {
@@ -563,32 +678,42 @@ public:
                 switch (vk_code) {
                 case 'C':
                     if (is_selecting)
-                        io.write_clipboard(
+                        Clipboard::get_instance().copy(
                             get_selected()
                         );
                     break;
                 case 'X':
-                    if (is_selecting) {
-                        io.write_clipboard(
+                    if (is_selecting && !is_read_only) {
+                        Clipboard::get_instance().copy(
                             get_selected()
                         );
                         delete_selected();
                         is_selecting = false;
                     }
                     break;
+                case 'V':
+                    if (!is_read_only)
+                        paste();
+                    break;
                 case 'A':
-                    vice_cursor_pos.line_index = text.size() - 1;
-                    vice_cursor_pos.line_it = --text.end();
-                    vice_cursor_pos.char_index = vice_cursor_pos.line_it->size();
+                    vice_cursor_pos.line_index = text.line_count() - 1;
+                    vice_cursor_pos.char_index = text.line_length(vice_cursor_pos.line_index);
 
                     cursor_pos.line_index = 0;
-                    cursor_pos.line_it = text.begin();
                     cursor_pos.char_index = 0;
 
                     check_cursor_pos(vice_cursor_pos);
                     
                     is_selecting = true;
                     break;
+                case 'Z':
+                    if (!is_read_only)
+                        undo();
+                    break;
+                case 'Y':
+                    if (!is_read_only)
+                        redo();
+                    break;
                 default:
                     break;
                 }
@@ -597,115 +722,74 @@ public:
 
 
     void set_wstring(std::wstring wstr) {
-        text.clear();
+        text.assign(wstr.data(), wstr.size());
+        history.clear();
+        columns.clear();
+        cursor_pos = { 0,0 };
+        first_line = 0;
+        horizontal_shift = 0;
+        invalidate();
+    }
 
-        size_t i = 0, j = 0;
-        while (j < wstr.size()) {
-            i = j;
-            while (wstr[j] != '\n' && j < wstr.size())++j;
-            text.push_back(Line(wstr.begin() + i, wstr.begin() + j));
-        }
+    // decode straight into the original buffer of the document
+    void set_utf_8_string(const char* str, size_t size) {
+        auto char_count = Utf8::decode(str, size, nullptr);
+        std::unique_ptr<Char[]> chars(new Char[char_count]);
+        Utf8::decode(str, size, chars.get());
 
-        if (text.empty())
-            text.push_back(Line());
-        cursor_pos = {
-            0,0,text.begin()
-        };
+        text.assign(std::move(chars), char_count);
+        history.clear();
+        columns.clear();
+        cursor_pos = { 0,0 };
         first_line = 0;
-        first_line_it = text.begin();
         horizontal_shift = 0;
+        invalidate();
     }
 
-    void set_utf_8_string(std::string str) {
-           text.clear();
-
-           int rest_byte_count = 0;
-           Char current_char = 0;
-
-           size_t i = 0, j = 0;
-           while (j < str.size()) {
-               i = j;
-               while (str[j] != '\n' && j < str.size())++j;
-               Line vline;
-               vline.reserve((j - i) / 3);
-               while (i < j) {
-                   auto ch = str[i];
-                   if (rest_byte_count == 0) {
-                       if ((ch & 0b1000'0000) == 0) {
-                           rest_byte_count = 0;
-                           current_char = ch & 0b0111'1111;
-                       }
-                       else if ((ch & 0b1110'0000) == 0b1100'0000) {
-                           rest_byte_count = 1;
-                           current_char = ch & 0b0001'1111;
-                       }
-                       else if ((ch & 0b1111'0000) == 0b1110'0000) {
-                           rest_byte_count = 2;
-                           current_char = ch & 0b0000'1111;
-                       }
-                       else if ((ch & 0b1111'1000) == 0b1111'0000) {
-                           rest_byte_count = 3;
-                           current_char = ch & 0b0000'0111;
-                       }
-                   }
-                   else {
-                       current_char <<= 6;
-                       current_char |= (ch & 0b0011'1111);
-                       --rest_byte_count;
-                   }
-
-                   if (rest_byte_count == 0)
-                       vline.push_back(current_char);
-
-                   ++i;
-               }
-               text.insert(text.end(), std::move(vline));
-               ++j;
-           }
-           if (text.empty())
-               text.push_back(Line());
-           cursor_pos = {
-               0,0,text.begin()
-           };
-           first_line = 0;
-           first_line_it = text.begin();
-           horizontal_shift = 0;
+    std::wstring get_wstring() {
+        return text.get_wstring(0, text.size());
     }
 
-    std::wstring get_wstring() {
-        std::wstring wstr;
-        for (auto it = text.begin(); it != text.end();) {
-            wstr.append(it->begin(), it->end());
-            if (++it != text.end())
-                wstr += '\n';
-        }
-        return wstr;
+    void set_chunk(Document::Chunk chunk) {
+        text.assign(std::move(chunk));
+        history.clear();
+        columns.clear();
+        cursor_pos = { 0,0 };
+        first_line = 0;
+        horizontal_shift = 0;
+        invalidate();
     }
 
-    std::string get_utf_8_string() {
-        std::string str;
-        for (auto it = text.begin(); it != text.end(); ) {
-            std::string line;
-            line.reserve(it->size());
-            for (auto ch : *it) {
-                if (ch < 0x007f)
-                    line.push_back(ch);
-                else if (ch < 0x07ff) {
-                    line.push_back(0b11000000 | ((ch >> 6) & 0b00011111));
-                    line.push_back(0b10000000 | (ch & 0b00111111));
-                }
-                else if (ch < 0xffff) {
-                    line.push_back(0b11100000 | ((ch >> 12) & 0b00001111));
-                    line.push_back(0b10000000 | ((ch >> 6) & 0b00111111));
-                    line.push_back(0b10000000 | (ch & 0b00111111));
-                }
+    // add the chunk to the end of the text, the cursor stays where it is
+    void append_chunk(Document::Chunk chunk) {
+        text.append(std::move(chunk));
+        columns.clear();
+        invalidate();
+    }
+
+    Document::Snapshot get_snapshot() {
+        return text.snapshot();
+    }
+
+    template <typename Sink>
+    void write_utf_8(Utf8Writer<Sink>& writer) {
+        text.for_each_span(
+            0, text.size(),
+            [&writer](const Char* chars, size_t count) {
+                writer.write(chars, count);
+                return true;
             }
-            str += line;
-            if (++it != text.end())
-                str += '\n';
-        }
+        );
+        writer.flush();
+    }
 
+    std::string get_utf_8_string() {
+        std::string str;
+        auto sink = [&str](const char* bytes, size_t count) {
+            str.append(bytes, count);
+        };
+        Utf8Writer<decltype(sink)> writer(sink);
+        write_utf_8(writer);
         return str;
     }
 };
-
@@ -0,0 +1,318 @@
+#pragma once
+
+// timing of the way from a keystroke to the screen
+// built with EDITOR_TRACE, the probes time the phases of every frame and
+// follow every keydown from its arrival, through the dispatch which
+// changes the document and the composition of the frame, to the present
+// without EDITOR_TRACE the probes are empty and nothing is compiled in
+
+#ifdef EDITOR_TRACE
+
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+// durations in nanoseconds, counted in buckets which are 1/32 of a power
+// of two wide, so a percentile is off by less than 4%
+class Histogram {
+    static constexpr size_t SUB_BUCKET_COUNT = 32;
+    static constexpr size_t BUCKET_COUNT = 60 * SUB_BUCKET_COUNT;
+
+    std::array<uint64_t, BUCKET_COUNT> counts{};
+    uint64_t count = 0;
+    uint64_t max = 0;
+
+    static size_t index_of(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT)
+            return size_t(value);
+        size_t shift = 0;
+        while ((value >> shift) >= 2 * SUB_BUCKET_COUNT)
+            ++shift;
+        return (shift + 1) * SUB_BUCKET_COUNT + size_t((value >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    // the smallest value of the bucket
+    static uint64_t value_of(size_t index) {
+        if (index < SUB_BUCKET_COUNT)
+            return index;
+        auto shift = index / SUB_BUCKET_COUNT - 1;
+        return (uint64_t(index % SUB_BUCKET_COUNT) + SUB_BUCKET_COUNT) << shift;
+    }
+
+public:
+    void add(uint64_t value) {
+        ++counts[index_of(value)];
+        ++count;
+        max = std::max(max, value);
+    }
+
+    uint64_t get_count() const {
+        return count;
+    }
+    uint64_t get_max() const {
+        return max;
+    }
+
+    // the largest value of the bucket which holds the percentile
+    uint64_t get_percentile(double percentile) const {
+        auto rank = uint64_t(percentile / 100 * count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts[i];
+            if (seen > rank)
+                return std::min(value_of(i + 1) - 1, max);
+        }
+        return max;
+    }
+};
+
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Phase : unsigned char {
+        // the callbacks of the input change the document
+        DISPATCH,
+        TEXT_AREA,
+        LINE_NUMBERS,
+        // the commands of the frame are drawn into the buffer
+        COMPOSE,
+        // the changed cells are found and written
+        PRESENT,
+        // a write to the console
+        WRITE,
+        COUNT
+    };
+
+private:
+    static constexpr const char* PHASE_NAMES[] = {
+        "dispatch",
+        "text_area",
+        "line_numbers",
+        "compose",
+        "present",
+        "write",
+    };
+
+    // the events kept for the chrome trace, the histograms count on
+    // after that
+    static constexpr size_t MAX_SPAN_COUNT = 1 << 20;
+    static constexpr size_t MAX_INPUT_COUNT = 1 << 18;
+
+    struct Span {
+        Phase phase;
+        int thread_id;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    // a keydown on its way to the screen
+    struct Input {
+        Clock::time_point arrived;
+        Clock::time_point dispatched;
+        Clock::time_point composed;
+        Clock::time_point presented;
+    };
+
+    std::mutex mutex;
+    Clock::time_point start = Clock::now();
+    std::vector<Span> spans;
+    std::array<Histogram, size_t(Phase::COUNT)> phase_histograms;
+    Histogram latency_histogram;
+    std::vector<Input> inputs;
+
+    // the inputs wait here for the frame which shows them:
+    // dispatched, then composed into a frame which is handed over, then
+    // presenting once the present thread has taken that frame
+    std::vector<Input> dispatching;
+    std::vector<Input> dispatched;
+    std::vector<Input> composed;
+    std::vector<Input> presenting;
+
+    Trace() = default;
+
+public:
+    static Trace& get_instance() {
+        static Trace instance;
+        return instance;
+    }
+
+    // the threads are numbered in the order they are first traced
+    static int get_thread_id() {
+        static std::atomic<int> next_id{ 0 };
+        thread_local int id = ++next_id;
+        return id;
+    }
+
+    class Scope {
+        Phase phase;
+        Clock::time_point start = Clock::now();
+
+    public:
+        explicit Scope(Phase phase) :
+            phase(phase) {}
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() {
+            Trace::get_instance().add_span(phase, start, Clock::now());
+        }
+    };
+
+    void add_span(Phase phase, Clock::time_point start, Clock::time_point end) {
+        std::lock_guard<std::mutex> lock(mutex);
+        phase_histograms[size_t(phase)].add(get_nanoseconds(start, end));
+        if (spans.size() < MAX_SPAN_COUNT)
+            spans.push_back({ phase, get_thread_id(), start, end });
+    }
+
+    // a keydown which the input thread received at arrived is dispatched
+    void input(Clock::time_point arrived) {
+        std::lock_guard<std::mutex> lock(mutex);
+        dispatching.push_back({ arrived, {}, {}, {} });
+    }
+
+    // the callbacks of the inputs have returned
+    void inputs_dispatched() {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& input : dispatching) {
+            input.dispatched = now;
+            dispatched.push_back(input);
+        }
+        dispatching.clear();
+    }
+
+    // a frame with the dispatched inputs is handed to the present thread
+    void frame_composed() {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& input : dispatched) {
+            input.composed = now;
+            composed.push_back(input);
+        }
+        dispatched.clear();
+    }
+
+    // the present thread took the last frame handed over, which shows
+    // the inputs of the frames it replaced too
+    void frame_taken() {
+        std::lock_guard<std::mutex> lock(mutex);
+        presenting.insert(presenting.end(), composed.begin(), composed.end());
+        composed.clear();
+    }
+
+    void frame_presented() {
+        auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& input : presenting) {
+            input.presented = now;
+            latency_histogram.add(get_nanoseconds(input.arrived, now));
+            if (inputs.size() < MAX_INPUT_COUNT)
+                inputs.push_back(input);
+        }
+        presenting.clear();
+    }
+
+    // the json of chrome://tracing and of perfetto, the phases are
+    // complete events on their threads, the inputs are async events from
+    // arrival to present, with the dispatch and the composition as steps
+    bool write_chrome_trace(const char* path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto file = std::fopen(path, "w");
+        if (!file)
+            return false;
+        std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        const char* separator = "";
+        for (auto& span : spans) {
+            std::fprintf(
+                file,
+                "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                "\"ts\": %.3f, \"dur\": %.3f}",
+                separator, PHASE_NAMES[size_t(span.phase)], span.thread_id,
+                get_microseconds(start, span.start), get_microseconds(span.start, span.end)
+            );
+            separator = ",\n";
+        }
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            auto& input = inputs[i];
+            struct {
+                const char* name;
+                const char* type;
+                Clock::time_point time;
+            } steps[] = {
+                { "keystroke", "b", input.arrived },
+                { "dispatched", "n", input.dispatched },
+                { "composed", "n", input.composed },
+                { "keystroke", "e", input.presented },
+            };
+            for (auto& step : steps) {
+                std::fprintf(
+                    file,
+                    "%s{\"name\": \"%s\", \"cat\": \"input\", \"ph\": \"%s\", \"id\": %zu, "
+                    "\"pid\": 1, \"tid\": 0, \"ts\": %.3f}",
+                    separator, step.name, step.type, i, get_microseconds(start, step.time)
+                );
+                separator = ",\n";
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+    // p50, p99 and max of the latency and of every phase
+    bool write_summary(const char* path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto file = std::fopen(path, "w");
+        if (!file)
+            return false;
+        std::fprintf(file, "%-16s %10s %10s %10s %10s\n", "", "count", "p50 us", "p99 us", "max us");
+        write_histogram(file, "keystroke", latency_histogram);
+        for (size_t i = 0; i < size_t(Phase::COUNT); ++i)
+            write_histogram(file, PHASE_NAMES[i], phase_histograms[i]);
+        return std::fclose(file) == 0;
+    }
+
+private:
+    static uint64_t get_nanoseconds(Clock::time_point start, Clock::time_point end) {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    static double get_microseconds(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    static void write_histogram(std::FILE* file, const char* name, const Histogram& histogram) {
+        std::fprintf(
+            file, "%-16s %10llu %10.1f %10.1f %10.1f\n",
+            name, (unsigned long long)histogram.get_count(),
+            histogram.get_percentile(50) / 1e3,
+            histogram.get_percentile(99) / 1e3,
+            histogram.get_max() / 1e3
+        );
+    }
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(phase) Trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(Trace::Phase::phase)
+#define TRACE_INPUT(arrived) Trace::get_instance().input(arrived)
+#define TRACE_INPUTS_DISPATCHED() Trace::get_instance().inputs_dispatched()
+#define TRACE_FRAME_COMPOSED() Trace::get_instance().frame_composed()
+#define TRACE_FRAME_TAKEN() Trace::get_instance().frame_taken()
+#define TRACE_FRAME_PRESENTED() Trace::get_instance().frame_presented()
+
+#else
+
+#define TRACE_SCOPE(phase) ((void)0)
+#define TRACE_INPUT(arrived) ((void)0)
+#define TRACE_INPUTS_DISPATCHED() ((void)0)
+#define TRACE_FRAME_COMPOSED() ((void)0)
+#define TRACE_FRAME_TAKEN() ((void)0)
+#define TRACE_FRAME_PRESENTED() ((void)0)
+
+#endif
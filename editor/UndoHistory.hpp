@@ -0,0 +1,227 @@
+#pragma once
+
+#include "Document.hpp"
+
+#include <vector>
+#include <deque>
+
+// undo and redo as a log of edits
+// an edit records where the text was inserted or erased and the text
+// itself as a slice, i.e. the pieces which refer to the buffers of the
+// document, so erasing the whole document is recorded in a few pieces
+// and undoing or redoing costs only as much as the edit
+// edits are collected in groups which are undone at once: adjacent
+// typing or deleting is coalesced, and when the records grow beyond
+// the memory limit the oldest groups are dropped
+class UndoHistory {
+    struct Edit {
+        bool is_insert;
+        size_t pos;
+        Document::Slice text;
+    };
+
+    struct Group {
+        std::vector<Edit> edits;
+
+        // the cursor offset before the first edit
+        size_t cursor = 0;
+
+        // a compound group takes any edit until it is ended,
+        // otherwise only the edits which continue the last one
+        bool is_compound = false;
+
+        size_t memory_size() const {
+            auto size = sizeof(Group) + edits.capacity() * sizeof(Edit);
+            for (auto& edit : edits)
+                size += edit.text.memory_size() - sizeof(Document::Slice);
+            return size;
+        }
+    };
+
+    std::deque<Group> undo_groups;
+    std::vector<Group> redo_groups;
+
+    // the last undo group can still take edits
+    bool is_open = false;
+    // the next group to be opened is compound
+    bool is_compound_next = false;
+
+    size_t memory_limit;
+    size_t memory_used = 0;
+
+public:
+    UndoHistory(size_t memory_limit = 16 << 20) :
+        memory_limit(memory_limit) {}
+
+    void clear() {
+        undo_groups.clear();
+        redo_groups.clear();
+        is_open = false;
+        is_compound_next = false;
+        memory_used = 0;
+    }
+
+    void set_memory_limit(size_t limit) {
+        memory_limit = limit;
+        shrink();
+    }
+
+    size_t get_memory_used() {
+        return memory_used;
+    }
+
+    bool can_undo() {
+        return !undo_groups.empty();
+    }
+    bool can_redo() {
+        return !redo_groups.empty();
+    }
+
+    // the edits from the next one until end_group() are undone together
+    void begin_group() {
+        is_open = false;
+        is_compound_next = true;
+    }
+
+    // the group stays open for the edits which continue its last one
+    void end_group() {
+        if (is_open)
+            undo_groups.back().is_compound = false;
+        is_compound_next = false;
+    }
+
+    // the next edit starts a new group
+    void close_group() {
+        is_open = false;
+        is_compound_next = false;
+    }
+
+    void insert(Document& text, size_t pos, const Document::Char* chars, size_t count, size_t cursor) {
+        if (count == 0)
+            return;
+        text.insert(pos, chars, count);
+        record(true, pos, text.slice(pos, count), cursor);
+    }
+
+    void insert(Document& text, size_t pos, const Document::Snapshot& snapshot, size_t cursor) {
+        if (snapshot.size() == 0)
+            return;
+        text.insert(pos, snapshot);
+        record(true, pos, text.slice(pos, snapshot.size()), cursor);
+    }
+
+    void erase(Document& text, size_t pos, size_t count, size_t cursor) {
+        if (count == 0)
+            return;
+        auto slice = text.slice(pos, count);
+        text.erase(pos, count);
+        record(false, pos, std::move(slice), cursor);
+    }
+
+    // cursor is set to where it was before the group
+    bool undo(Document& text, size_t& cursor) {
+        if (undo_groups.empty())
+            return false;
+        close_group();
+
+        auto& group = undo_groups.back();
+        for (auto it = group.edits.rbegin(); it != group.edits.rend(); ++it) {
+            if (it->is_insert)
+                text.erase(it->pos, it->text.size());
+            else
+                text.insert(it->pos, it->text);
+        }
+        cursor = group.cursor;
+
+        redo_groups.push_back(std::move(group));
+        undo_groups.pop_back();
+        return true;
+    }
+
+    // cursor is set to the end of the last edit of the group
+    bool redo(Document& text, size_t& cursor) {
+        if (redo_groups.empty())
+            return false;
+        close_group();
+
+        auto& group = redo_groups.back();
+        for (auto& edit : group.edits) {
+            if (edit.is_insert)
+                text.insert(edit.pos, edit.text);
+            else
+                text.erase(edit.pos, edit.text.size());
+        }
+        auto& last = group.edits.back();
+        cursor = last.is_insert ? last.pos + last.text.size() : last.pos;
+
+        undo_groups.push_back(std::move(group));
+        redo_groups.pop_back();
+        return true;
+    }
+
+private:
+    void open_group(size_t cursor) {
+        if (!redo_groups.empty()) {
+            for (auto& group : redo_groups)
+                memory_used -= group.memory_size();
+            redo_groups.clear();
+        }
+        undo_groups.emplace_back();
+        undo_groups.back().cursor = cursor;
+        undo_groups.back().is_compound = is_compound_next;
+        memory_used += undo_groups.back().memory_size();
+        is_open = true;
+        is_compound_next = false;
+    }
+
+    void record(bool is_insert, size_t pos, Document::Slice slice, size_t cursor) {
+        if (!is_open || !(undo_groups.back().is_compound || continues(is_insert, pos, slice)))
+            open_group(cursor);
+
+        auto& group = undo_groups.back();
+        memory_used -= group.memory_size();
+        if (!group.edits.empty() && continues(is_insert, pos, slice)) {
+            auto& last = group.edits.back();
+            if (is_insert)
+                last.text.append(slice);
+            else if (pos == last.pos)
+                // deleting forwards
+                last.text.append(slice);
+            else {
+                // deleting backwards
+                last.text.prepend(slice);
+                last.pos = pos;
+            }
+        }
+        else {
+            group.edits.push_back({ is_insert, pos, std::move(slice) });
+        }
+        memory_used += group.memory_size();
+
+        shrink();
+    }
+
+    // the edit extends the last edit of the open group
+    bool continues(bool is_insert, size_t pos, const Document::Slice& slice) {
+        if (!is_open || undo_groups.back().edits.empty())
+            return false;
+        auto& last = undo_groups.back().edits.back();
+        if (last.is_insert != is_insert)
+            return false;
+        if (is_insert)
+            return pos == last.pos + last.text.size();
+        return pos == last.pos || pos + slice.size() == last.pos;
+    }
+
+    // drop the oldest groups, but never the one being recorded
+    void shrink() {
+        while (memory_used > memory_limit && !redo_groups.empty()) {
+            memory_used -= redo_groups.front().memory_size();
+            redo_groups.erase(redo_groups.begin());
+        }
+        while (memory_used > memory_limit && undo_groups.size() > 1) {
+            memory_used -= undo_groups.front().memory_size();
+            undo_groups.pop_front();
+        }
+    }
+};
@@ -0,0 +1,402 @@
+#pragma once
+
+#include "Simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// utf-8 decoding and encoding
+// runs of ascii are copied 16 or 32 bytes at a time, the other bytes
+// are validated one sequence after another: every malformed sequence
+// is replaced with U+FFFD, and "\r\n" is read as '\n'
+// with a 16-bit wchar_t, code points above U+FFFF become surrogate pairs
+class Utf8 {
+public:
+    using Char = wchar_t;
+    static constexpr Char REPLACEMENT_CHARACTER = 0xfffd;
+
+    // decode into out and return the number of chars written
+    // with out == nullptr, only count the chars
+    static size_t decode(const char* str, size_t size, Char* out) {
+        auto bytes = reinterpret_cast<const unsigned char*>(str);
+        if (out)
+            return decode_impl<true>(bytes, size, out, select_ascii_run<true>());
+        else
+            return decode_impl<false>(bytes, size, out, select_ascii_run<false>());
+    }
+
+    // encode one code point into out, which has room for 4 bytes,
+    // and return the number of bytes
+    // surrogates and invalid code points are encoded as U+FFFD
+    static size_t encode(uint32_t ch, char* out) {
+        if ((ch >= 0xd800 && ch <= 0xdfff) || ch > 0x10ffff)
+            ch = REPLACEMENT_CHARACTER;
+
+        if (ch < 0x80) {
+            out[0] = char(ch);
+            return 1;
+        }
+        if (ch < 0x800) {
+            out[0] = char(0b1100'0000 | (ch >> 6));
+            out[1] = char(0b1000'0000 | (ch & 0b0011'1111));
+            return 2;
+        }
+        if (ch < 0x10000) {
+            out[0] = char(0b1110'0000 | (ch >> 12));
+            out[1] = char(0b1000'0000 | ((ch >> 6) & 0b0011'1111));
+            out[2] = char(0b1000'0000 | (ch & 0b0011'1111));
+            return 3;
+        }
+        out[0] = char(0b1111'0000 | (ch >> 18));
+        out[1] = char(0b1000'0000 | ((ch >> 12) & 0b0011'1111));
+        out[2] = char(0b1000'0000 | ((ch >> 6) & 0b0011'1111));
+        out[3] = char(0b1000'0000 | (ch & 0b0011'1111));
+        return 4;
+    }
+
+private:
+    // copy the leading bytes which are neither '\r' nor above 0x7f,
+    // return the number of them
+    using AsciiRun = size_t(*)(const unsigned char* str, size_t size, Char* out);
+
+    template <bool write>
+    static AsciiRun select_ascii_run() {
+#ifdef EDITOR_SSE2
+        if (Simd::has_avx2())
+            return ascii_run_avx2<write>;
+        return ascii_run_sse2<write>;
+#else
+        return ascii_run_scalar<write>;
+#endif
+    }
+
+    static bool is_plain_ascii(unsigned char ch) {
+        return ch < 0x80 && ch != '\r';
+    }
+
+    template <bool write>
+    static size_t ascii_run_scalar(const unsigned char* str, size_t size, Char* out) {
+        size_t i = 0;
+        for (; i < size && is_plain_ascii(str[i]); ++i)
+            if (write)
+                out[i] = str[i];
+        return i;
+    }
+
+#ifdef EDITOR_SSE2
+    static void widen_16(__m128i bytes, Char* out) {
+        auto zero = _mm_setzero_si128();
+        auto low = _mm_unpacklo_epi8(bytes, zero);
+        auto high = _mm_unpackhi_epi8(bytes, zero);
+        if constexpr (sizeof(Char) == 2) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), high);
+        }
+        else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 12), _mm_unpackhi_epi16(high, zero));
+        }
+    }
+
+    template <bool write>
+    static size_t ascii_run_sse2(const unsigned char* str, size_t size, Char* out) {
+        auto cr = _mm_set1_epi8('\r');
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+            uint32_t mask =
+                _mm_movemask_epi8(bytes) |
+                _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, cr));
+            if (mask)
+                return i + ascii_run_scalar<write>(str + i, 16, out + i);
+            if (write)
+                widen_16(bytes, out + i);
+        }
+        return i + ascii_run_scalar<write>(str + i, size - i, out + i);
+    }
+
+    template <bool write>
+    EDITOR_TARGET_AVX2
+    static size_t ascii_run_avx2(const unsigned char* str, size_t size, Char* out) {
+        auto cr = _mm256_set1_epi8('\r');
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+            uint32_t mask =
+                _mm256_movemask_epi8(bytes) |
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, cr));
+            if (mask)
+                return i + ascii_run_scalar<write>(str + i, 32, out + i);
+            if (write) {
+                auto dst = out + i;
+                auto low = _mm256_castsi256_si128(bytes);
+                auto high = _mm256_extracti128_si256(bytes, 1);
+                if constexpr (sizeof(Char) == 2) {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_cvtepu8_epi16(low));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 16), _mm256_cvtepu8_epi16(high));
+                }
+                else {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_cvtepu8_epi32(low));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 16), _mm256_cvtepu8_epi32(high));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+                }
+            }
+        }
+        return i + ascii_run_scalar<write>(str + i, size - i, out + i);
+    }
+#endif
+
+    template <bool write>
+    static void emit(Char* out, size_t& n, uint32_t code_point) {
+        if (sizeof(Char) == 2 && code_point > 0xffff) {
+            code_point -= 0x10000;
+            if (write) {
+                out[n] = Char(0xd800 | (code_point >> 10));
+                out[n + 1] = Char(0xdc00 | (code_point & 0x3ff));
+            }
+            n += 2;
+        }
+        else {
+            if (write)
+                out[n] = Char(code_point);
+            ++n;
+        }
+    }
+
+    // decode the sequence beginning at str[i], return the index after it
+    // a malformed sequence is consumed up to the first unexpected byte
+    template <bool write>
+    static size_t decode_sequence(
+        const unsigned char* str, size_t size, size_t i,
+        Char* out, size_t& n
+    ) {
+        auto lead = str[i];
+        int rest_byte_count;
+        uint32_t code_point;
+        // the range of the second byte, the others are always 0x80-0xbf
+        unsigned char low = 0x80, high = 0xbf;
+
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            rest_byte_count = 1;
+            code_point = lead & 0b0001'1111;
+        }
+        else if (lead >= 0xe0 && lead <= 0xef) {
+            rest_byte_count = 2;
+            code_point = lead & 0b0000'1111;
+            if (lead == 0xe0)
+                low = 0xa0;
+            // surrogates
+            else if (lead == 0xed)
+                high = 0x9f;
+        }
+        else if (lead >= 0xf0 && lead <= 0xf4) {
+            rest_byte_count = 3;
+            code_point = lead & 0b0000'0111;
+            if (lead == 0xf0)
+                low = 0x90;
+            else if (lead == 0xf4)
+                high = 0x8f;
+        }
+        else {
+            emit<write>(out, n, REPLACEMENT_CHARACTER);
+            return i + 1;
+        }
+
+        ++i;
+        for (; rest_byte_count > 0; --rest_byte_count, ++i) {
+            if (i >= size || str[i] < low || str[i] > high) {
+                emit<write>(out, n, REPLACEMENT_CHARACTER);
+                return i;
+            }
+            code_point <<= 6;
+            code_point |= str[i] & 0b0011'1111;
+            low = 0x80, high = 0xbf;
+        }
+        emit<write>(out, n, code_point);
+        return i;
+    }
+
+    template <bool write>
+    static size_t decode_impl(
+        const unsigned char* str, size_t size,
+        Char* out, AsciiRun ascii_run
+    ) {
+        size_t i = 0, n = 0;
+        while (i < size) {
+            auto run = ascii_run(str + i, size - i, write ? out + n : nullptr);
+            i += run;
+            n += run;
+
+            // stay here until the next plain ascii byte
+            while (i < size && !is_plain_ascii(str[i])) {
+                // the well-formed 2 and 3 byte sequences,
+                // which are most of the non-ascii text
+                auto lead = str[i];
+                if (lead >= 0xc2 && lead <= 0xdf && i + 1 < size &&
+                    (str[i + 1] & 0b1100'0000) == 0b1000'0000) {
+                    emit<write>(out, n, (lead & 0b0001'1111) << 6 | (str[i + 1] & 0b0011'1111));
+                    i += 2;
+                }
+                else if (lead >= 0xe1 && lead <= 0xef && lead != 0xed && i + 2 < size &&
+                    (str[i + 1] & 0b1100'0000) == 0b1000'0000 &&
+                    (str[i + 2] & 0b1100'0000) == 0b1000'0000) {
+                    emit<write>(
+                        out, n,
+                        (lead & 0b0000'1111) << 12 |
+                        (str[i + 1] & 0b0011'1111) << 6 |
+                        (str[i + 2] & 0b0011'1111)
+                    );
+                    i += 3;
+                }
+                else if (str[i] == '\r') {
+                    if (i + 1 < size && str[i + 1] == '\n') {
+                        ++i;
+                        break;
+                    }
+                    emit<write>(out, n, '\r');
+                    ++i;
+                }
+                else
+                    i = decode_sequence<write>(str, size, i, out, n);
+            }
+        }
+        return n;
+    }
+};
+
+// utf-8 encoding into fixed-size blocks
+// the bytes are handed to sink(const char* bytes, size_t count) one block
+// at a time, so the whole text is never held as a string
+// runs of ascii are narrowed 8 chars at a time, surrogate pairs may be
+// split between two calls of write(), unpaired surrogates and invalid
+// code points are written as U+FFFD
+template <typename Sink>
+class Utf8Writer {
+public:
+    using Char = wchar_t;
+    static constexpr size_t BLOCK_SIZE = 1 << 16;
+
+private:
+    Sink sink;
+    bool crlf;
+
+    std::unique_ptr<char[]> block;
+    size_t used = 0;
+
+    // a high surrogate waiting for the low one
+    uint32_t high_surrogate = 0;
+
+public:
+    // with crlf, '\n' is written as "\r\n"
+    Utf8Writer(Sink sink, bool crlf = false) :
+        sink(std::move(sink)), crlf(crlf), block(new char[BLOCK_SIZE]) {}
+
+    void write(const Char* chars, size_t count) {
+        size_t i = 0;
+        while (i < count) {
+            // room for 8 ascii chars or one code point
+            if (BLOCK_SIZE - used < 8)
+                flush_block();
+
+            if (high_surrogate == 0) {
+                i += ascii_run(chars + i, count - i);
+                if (i == count || BLOCK_SIZE - used < 8)
+                    continue;
+            }
+
+            uint32_t ch = chars[i++];
+            if (high_surrogate) {
+                if (ch >= 0xdc00 && ch <= 0xdfff) {
+                    put(0x10000 + ((high_surrogate - 0xd800) << 10) + (ch - 0xdc00));
+                    high_surrogate = 0;
+                    continue;
+                }
+                high_surrogate = 0;
+                put(Utf8::REPLACEMENT_CHARACTER);
+            }
+            if (sizeof(Char) == 2 && ch >= 0xd800 && ch <= 0xdbff)
+                high_surrogate = ch;
+            else if (ch == '\n' && crlf) {
+                block[used++] = '\r';
+                block[used++] = '\n';
+            }
+            else
+                put(ch);
+        }
+    }
+
+    // write out everything, a pending high surrogate becomes U+FFFD
+    void flush() {
+        if (high_surrogate) {
+            high_surrogate = 0;
+            if (BLOCK_SIZE - used < 8)
+                flush_block();
+            put(Utf8::REPLACEMENT_CHARACTER);
+        }
+        flush_block();
+    }
+
+    Sink& get_sink() {
+        return sink;
+    }
+
+private:
+    void flush_block() {
+        if (used > 0)
+            sink(block.get(), used);
+        used = 0;
+    }
+
+    bool is_plain_ascii(Char ch) {
+        return uint32_t(ch) < 0x80 && !(ch == '\n' && crlf);
+    }
+
+    // narrow the leading ascii chars while the block has room,
+    // return the number of them
+    size_t ascii_run(const Char* chars, size_t count) {
+        auto out = block.get() + used;
+        auto room = BLOCK_SIZE - used;
+        if (count > room)
+            count = room;
+        size_t i = 0;
+#ifdef EDITOR_SSE2
+        constexpr size_t LANES = 16 / sizeof(Char);
+        auto not_ascii = sizeof(Char) == 2 ?
+            _mm_set1_epi16(short(0xff80)) : _mm_set1_epi32(int(0xffffff80));
+        auto line_feed = crlf ?
+            (sizeof(Char) == 2 ? _mm_set1_epi16('\n') : _mm_set1_epi32('\n')) :
+            _mm_set1_epi32(-1);
+        auto zero = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8) {
+            auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+            auto v1 = LANES == 8 ?
+                zero : _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i + 4));
+            auto special = _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(v0, not_ascii), _mm_and_si128(v1, not_ascii)),
+                sizeof(Char) == 2 ?
+                _mm_cmpeq_epi16(v0, line_feed) :
+                _mm_or_si128(_mm_cmpeq_epi32(v0, line_feed), _mm_cmpeq_epi32(v1, line_feed))
+            );
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(special, zero)) != 0xffff)
+                break;
+            auto words = sizeof(Char) == 2 ? v0 : _mm_packs_epi32(v0, v1);
+            _mm_storel_epi64(
+                reinterpret_cast<__m128i*>(out + i),
+                _mm_packus_epi16(words, words)
+            );
+        }
+#endif
+        for (; i < count && is_plain_ascii(chars[i]); ++i)
+            out[i] = char(chars[i]);
+        used += i;
+        return i;
+    }
+
+    void put(uint32_t ch) {
+        used += Utf8::encode(ch, block.get() + used);
+    }
+};
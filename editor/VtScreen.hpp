@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Platform.hpp"
+#include "FrameBuffer.hpp"
+#include "UnicodeWidth.hpp"
+#include "Utf8.hpp"
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <string>
+
+// a terminal which understands vt escape sequences
+// a frame is collected in one string and written with a single write(),
+// the cursor is moved relatively where that is shorter, and colors are
+// only set when they differ from the ones of the previous cell
+class VtScreen {
+    std::string frame;
+
+    // where the terminal cursor is, -1 if unknown
+    int cursor_x = -1;
+    int cursor_y = -1;
+
+    // the attributes which the terminal draws with, 0xffff if unknown
+    WORD attributes = 0xffff;
+
+    COORD size{ 0, 0 };
+
+public:
+    VtScreen() {
+        // the alternate screen, the cursor hidden
+        write_all("\x1b[?1049h\x1b[?25l");
+    }
+
+    VtScreen(const VtScreen&) = delete;
+    VtScreen& operator=(const VtScreen&) = delete;
+
+    COORD get_size() {
+        winsize ws{};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0)
+            return { SHORT(ws.ws_col), SHORT(ws.ws_row) };
+        return { 80, 24 };
+    }
+
+    // the terminal decides its size, the state of the cursor is lost
+    void set_size(COORD size) {
+        this->size = size;
+        cursor_x = cursor_y = -1;
+        attributes = 0xffff;
+    }
+
+    // append the cells [first, last) of the row y to the frame
+    // the terminal draws a wide char over its continuation cell, so the
+    // continuation cells are skipped
+    void write(const FrameBuffer& frame, SHORT first, SHORT last, SHORT y) {
+        auto chars = frame.get_chars(y);
+        auto attributes = frame.get_attributes(y);
+        move_to(first, y);
+        for (auto x = first; x < last; ++x) {
+            auto ch = chars[x];
+            if (ch == CONTINUATION_CHAR)
+                continue;
+            set_attributes(attributes[x]);
+            append_char(ch);
+            cursor_x += UnicodeWidth::get(char32_t(ch));
+        }
+        // the cursor waits for wrapping at the end of the row
+        if (cursor_x >= size.X)
+            cursor_x = cursor_y = -1;
+    }
+
+    // an escape sequence which neither moves the cursor nor changes the
+    // colors goes out with the frame
+    void write_sequence(const std::string& sequence) {
+        frame += sequence;
+    }
+
+    void end_frame() {
+        if (frame.empty())
+            return;
+        write_all(frame);
+        frame.clear();
+    }
+
+    ~VtScreen() {
+        write_all("\x1b[0m\x1b[?25h\x1b[?1049l");
+    }
+
+private:
+    void move_to(int x, int y) {
+        if (x == cursor_x && y == cursor_y)
+            return;
+        if (y == cursor_y && x == 0) {
+            frame += '\r';
+        }
+        else if (y == cursor_y) {
+            frame += "\x1b[";
+            frame += std::to_string(x > cursor_x ? x - cursor_x : cursor_x - x);
+            frame += x > cursor_x ? 'C' : 'D';
+        }
+        else if (cursor_y >= 0 && y == cursor_y + 1 && x == 0) {
+            frame += "\r\n";
+        }
+        else {
+            frame += "\x1b[";
+            frame += std::to_string(y + 1);
+            frame += ';';
+            frame += std::to_string(x + 1);
+            frame += 'H';
+        }
+        cursor_x = x;
+        cursor_y = y;
+    }
+
+    // the console colors have the bits red, green and blue in the reverse
+    // order of the ansi colors
+    static int to_ansi(WORD color) {
+        return
+            ((color & FOREGROUND_RED) ? 1 : 0) |
+            ((color & FOREGROUND_GREEN) ? 2 : 0) |
+            ((color & FOREGROUND_BLUE) ? 4 : 0);
+    }
+
+    void set_attributes(WORD new_attributes) {
+        if (new_attributes == attributes)
+            return;
+        WORD foreground = new_attributes & 0x0f;
+        WORD background = (new_attributes >> 4) & 0x0f;
+        bool foreground_changed = attributes == 0xffff || foreground != (attributes & 0x0f);
+        bool background_changed = attributes == 0xffff || background != ((attributes >> 4) & 0x0f);
+
+        frame += "\x1b[";
+        if (foreground_changed) {
+            frame += std::to_string(
+                ((foreground & FOREGROUND_INTENSITY) ? 90 : 30) + to_ansi(foreground)
+            );
+            if (background_changed)
+                frame += ';';
+        }
+        if (background_changed)
+            frame += std::to_string(
+                ((background & FOREGROUND_INTENSITY) ? 100 : 40) + to_ansi(background)
+            );
+        frame += 'm';
+        attributes = new_attributes;
+    }
+
+    void append_char(wchar_t ch) {
+        // no control chars reach the terminal
+        if (ch < 0x20 || ch == 0x7f)
+            ch = ' ';
+        char bytes[4];
+        frame.append(bytes, Utf8::encode(uint32_t(ch), bytes));
+    }
+
+    static void write_all(const std::string& str) {
+        size_t written = 0;
+        while (written < str.size()) {
+            auto n = ::write(STDOUT_FILENO, str.data() + written, str.size() - written);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return;
+            }
+            written += size_t(n);
+        }
+    }
+};
@@ -1,8 +1,12 @@
 ﻿#include "Editor.hpp"
 #include <string>
+#ifndef _WIN32
+#include <csignal>
+#endif
 
 Editor editor;
 
+#ifdef _WIN32
 BOOL handle_exit(DWORD dwCtrlType) {
     if (dwCtrlType == CTRL_CLOSE_EVENT)
         editor.save_to_temp_file();
@@ -18,11 +22,34 @@ std::wstring ansi_to_unicode(const char* src_str) {
     delete[] w_cstr;
     return wstr;
 }
+#else
+// the terminal was closed, the text is saved after the loop returns
+volatile std::sig_atomic_t hung_up = 0;
+
+void handle_exit(int signal) {
+    if (signal == SIGHUP)
+        hung_up = 1;
+    editor.quit();
+}
+
+// the arguments are utf-8 on the other platforms
+std::wstring ansi_to_unicode(const char* src_str) {
+    std::string str = src_str;
+    std::wstring wstr(str.size(), L'\0');
+    wstr.resize(Utf8::decode(str.data(), str.size(), wstr.data()));
+    return wstr;
+}
+#endif
 
 int main(int argc, char* argv[]) {
+#ifdef _WIN32
     SetConsoleCtrlHandler(
         handle_exit, true
     );
+#else
+    std::signal(SIGHUP, handle_exit);
+    std::signal(SIGTERM, handle_exit);
+#endif
     if (argc == 2) {
         auto file_name_unicode = ansi_to_unicode(argv[1]);
         if (!editor.read_from_temp_file(file_name_unicode))
@@ -31,4 +58,15 @@ int main(int argc, char* argv[]) {
     }
 
     editor.loop();
+#ifndef _WIN32
+    if (hung_up)
+        editor.save_to_temp_file();
+#endif
+
+#ifdef EDITOR_TRACE
+    // the last frame is presented before the trace is written
+    TerminalIO::get_instance().finish();
+    Trace::get_instance().write_chrome_trace("editor-trace.json");
+    Trace::get_instance().write_summary("editor-trace.txt");
+#endif
 }
\ No newline at end of file
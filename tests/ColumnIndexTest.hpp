@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Test.hpp"
+#include "ColumnIndex.hpp"
+
+#include <string>
+
+class ColumnIndexTest {
+    static void check_line(Test& test, const std::wstring& line) {
+        Document text;
+        text.assign(line.data(), line.size());
+        ColumnIndex columns(text);
+        // against the widths summed one char at a time
+        size_t width = 0;
+        for (size_t i = 0; i <= line.size(); ++i) {
+            CHECK(test, columns.column_of(0, i) == width);
+            if (i < line.size())
+                width += UnicodeWidth::get(char32_t(line[i]));
+        }
+    }
+
+public:
+    static void run(Test& test) {
+        check_line(test, std::wstring(200, L'a'));
+
+        // a wide char and a combining mark add up to two columns, so the
+        // first stride is as wide as it has chars without being ascii
+        auto mixed = L"\x4e2d\x0301" + std::wstring(62, L'a') + L"\x4e2d" + std::wstring(70, L'b');
+        check_line(test, mixed);
+        {
+            Document text;
+            text.assign(mixed.data(), mixed.size());
+            ColumnIndex columns(text);
+            CHECK(test, columns.column_of(0, 64) == 64);
+            CHECK(test, columns.column_of(0, 1) == 2);
+            CHECK(test, columns.column_of(0, 2) == 2);
+            CHECK(test, columns.column_of(0, 3) == 3);
+            CHECK(test, columns.char_at(0, 2) == 1);
+        }
+
+        // an ascii stride which an edit makes wide
+        {
+            auto line = std::wstring(130, L'a');
+            Document text;
+            text.assign(line.data(), line.size());
+            ColumnIndex columns(text);
+            CHECK(test, columns.column_of(0, 100) == 100);
+            text.erase(0, 2);
+            const wchar_t wide[] = { 0x4e2d, 0x0301 };
+            text.insert(0, wide, 2);
+            columns.invalidate(0, 0);
+            CHECK(test, columns.column_of(0, 1) == 2);
+            CHECK(test, columns.column_of(0, 100) == 100);
+        }
+    }
+};
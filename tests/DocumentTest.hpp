@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Test.hpp"
+#include "Document.hpp"
+
+#include <string>
+#include <random>
+#include <algorithm>
+
+class DocumentTest {
+    // the text and the line lookup against a plain string
+    static void check_text(Test& test, const Document& text, const std::wstring& expected) {
+        CHECK(test, text.size() == expected.size());
+        CHECK(test, text.get_wstring(0, text.size()) == expected);
+
+        size_t line = 0, start = 0;
+        for (size_t pos = 0; pos <= expected.size(); ++pos) {
+            if (pos == expected.size() || expected[pos] == '\n') {
+                CHECK(test, text.line_start(line) == start);
+                CHECK(test, text.line_length(line) == pos - start);
+                ++line;
+                start = pos + 1;
+            }
+        }
+        CHECK(test, text.line_count() == line);
+
+        line = 0;
+        for (size_t pos = 0; pos < expected.size(); ++pos) {
+            CHECK(test, text.line_of(pos) == line);
+            if (expected[pos] == '\n')
+                ++line;
+        }
+        CHECK(test, text.line_of(expected.size()) == line);
+    }
+
+public:
+    static void run(Test& test) {
+        // insertions and erasures which cut through the pieces
+        {
+            std::wstring expected = L"first\nsecond\nthird";
+            Document text;
+            text.assign(expected.data(), expected.size());
+            check_text(test, text, expected);
+
+            std::mt19937 random(1);
+            const wchar_t alphabet[] = L"ab\n\x4e2d";
+            for (int i = 0; i < 300; ++i) {
+                auto pos = random() % (expected.size() + 1);
+                if (random() % 3 != 0 || expected.empty()) {
+                    std::wstring chars(random() % 8 + 1, L'\0');
+                    for (auto& ch : chars)
+                        ch = alphabet[random() % 4];
+                    text.insert(pos, chars.data(), chars.size());
+                    expected.insert(pos, chars);
+                }
+                else {
+                    auto count = std::min<size_t>(random() % 12, expected.size() - pos);
+                    text.erase(pos, count);
+                    expected.erase(pos, count);
+                }
+            }
+            check_text(test, text, expected);
+
+            // everything but the first and the last char, over all the pieces
+            text.erase(1, expected.size() - 2);
+            expected.erase(1, expected.size() - 2);
+            check_text(test, text, expected);
+        }
+
+        // an insertion larger than an add buffer spans several of them
+        {
+            std::wstring expected;
+            for (int i = 0; i < 50000; ++i)
+                expected += L"line\n";
+            Document text;
+            text.insert(0, expected.data(), expected.size());
+            text.insert(3, L"\n\n", 2);
+            expected.insert(3, L"\n\n");
+            check_text(test, text, expected);
+        }
+
+        // a snapshot keeps its text while the document changes
+        {
+            std::wstring original = L"one\ntwo\n";
+            Document text;
+            text.assign(original.data(), original.size());
+            auto snapshot = text.snapshot();
+            text.erase(0, 4);
+            text.insert(0, L"three\n", 6);
+
+            Document copy;
+            copy.insert(0, snapshot);
+            check_text(test, copy, original);
+            check_text(test, text, L"three\ntwo\n");
+        }
+
+        // chunks appended one after another
+        {
+            Document text;
+            std::wstring expected;
+            for (auto part : { L"ab\nc", L"", L"d\n\ne" }) {
+                std::wstring chunk = part;
+                std::unique_ptr<Document::Char[]> chars(new Document::Char[chunk.size()]);
+                std::copy(chunk.begin(), chunk.end(), chars.get());
+                text.append(Document::Chunk(std::move(chars), chunk.size()));
+                expected += chunk;
+            }
+            check_text(test, text, expected);
+        }
+    }
+};
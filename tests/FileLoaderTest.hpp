@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Test.hpp"
+#include "FileLoader.hpp"
+
+#include <string>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+class FileLoaderTest {
+    static constexpr const char* FILE_NAME = "FileLoaderTest.tmp";
+
+    static bool write_file(const std::string& bytes) {
+        auto file = std::fopen(FILE_NAME, "wb");
+        if (!file)
+            return false;
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        return std::fclose(file) == 0;
+    }
+
+    // load the file as the editor does, and compare the chunks put
+    // together with the file decoded at once
+    // the head is not counted as a chunk
+    static void check_load(Test& test, const std::string& bytes, size_t head_line_count, size_t min_chunk_count = 0) {
+        CHECK(test, write_file(bytes));
+        std::wstring expected(bytes.size(), L'\0');
+        expected.resize(Utf8::decode(bytes.data(), bytes.size(), &expected[0]));
+
+        Document text;
+        size_t chunk_count = 0;
+        {
+            FileLoader loader(std::wstring(FILE_NAME, FILE_NAME + std::strlen(FILE_NAME)));
+            CHECK(test, loader.is_open());
+            text.assign(loader.load_head(head_line_count));
+            loader.start();
+            while (true) {
+                bool finished = loader.is_finished();
+                for (auto& chunk : loader.take_chunks()) {
+                    text.append(std::move(chunk));
+                    ++chunk_count;
+                }
+                if (finished)
+                    break;
+                std::this_thread::yield();
+            }
+            CHECK(test, loader.get_progress() == 100);
+        }
+        std::remove(FILE_NAME);
+
+        CHECK(test, text.get_wstring(0, text.size()) == expected);
+        CHECK(test, text.line_count() == std::count(expected.begin(), expected.end(), L'\n') + size_t(1));
+        CHECK(test, chunk_count >= min_chunk_count);
+    }
+
+public:
+    static void run(Test& test) {
+        check_load(test, "", 10);
+        check_load(test, "one line", 10);
+        check_load(test, "a\r\nb\r\nc", 1);
+
+        // files of more than two chunks, the first line shifts the ends of
+        // the chunks over every byte of a pattern of multi-byte sequences
+        // and "\r\n", so that every way to split them is met
+        const std::string pattern = "ab\xe4\xb8\xad\r\n\xf0\x9f\x98\x80";
+        std::string body;
+        while (body.size() < (9 << 20))
+            body += pattern;
+        for (size_t shift = 0; shift < pattern.size(); ++shift)
+            check_load(test, std::string(shift, 'x') + "\n" + body, 1, 2);
+    }
+};
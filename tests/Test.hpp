@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+// a minimal checking harness
+// every failed check is printed with its place, main returns non-zero
+// when any check failed
+class Test {
+    int failure_count = 0;
+
+public:
+    void check(bool condition, const char* expression, const char* file, int line) {
+        if (condition)
+            return;
+        ++failure_count;
+        std::printf("%s:%d: failed: %s\n", file, line, expression);
+    }
+
+    int get_failure_count() const {
+        return failure_count;
+    }
+};
+
+#define CHECK(test, condition) (test).check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Test.hpp"
+#include "UndoHistory.hpp"
+
+#include <string>
+
+class UndoHistoryTest {
+    static std::wstring text_of(const Document& text) {
+        return text.get_wstring(0, text.size());
+    }
+
+    // type the chars one by one, as the text area does
+    static void type(UndoHistory& history, Document& text, size_t& cursor, const std::wstring& chars) {
+        for (auto ch : chars) {
+            history.insert(text, cursor, &ch, 1, cursor);
+            ++cursor;
+        }
+    }
+
+public:
+    static void run(Test& test) {
+        // typing is coalesced into one group, undone and redone at once
+        {
+            Document text;
+            UndoHistory history;
+            size_t cursor = 0;
+            type(history, text, cursor, L"hello");
+            CHECK(test, text_of(text) == L"hello");
+
+            CHECK(test, history.undo(text, cursor));
+            CHECK(test, text_of(text) == L"");
+            CHECK(test, cursor == 0);
+            CHECK(test, !history.can_undo());
+
+            CHECK(test, history.redo(text, cursor));
+            CHECK(test, text_of(text) == L"hello");
+            CHECK(test, cursor == 5);
+            CHECK(test, !history.redo(text, cursor));
+        }
+
+        // deleting backwards and forwards is coalesced, a jump is not
+        {
+            std::wstring original = L"abcdef";
+            Document text;
+            text.assign(original.data(), original.size());
+            UndoHistory history;
+            size_t cursor = 4;
+            // backspace twice at 4, delete twice at 2
+            history.erase(text, 3, 1, cursor--);
+            history.erase(text, 2, 1, cursor--);
+            history.erase(text, 2, 1, cursor);
+            history.erase(text, 2, 1, cursor);
+            CHECK(test, text_of(text) == L"ab");
+            // typing elsewhere starts a group of its own
+            cursor = 0;
+            type(history, text, cursor, L"x");
+
+            CHECK(test, history.undo(text, cursor));
+            CHECK(test, text_of(text) == L"ab");
+            CHECK(test, history.undo(text, cursor));
+            CHECK(test, text_of(text) == original);
+            CHECK(test, cursor == 4);
+            CHECK(test, !history.can_undo());
+        }
+
+        // close_group() ends the coalescing, a compound group takes any
+        // edit until end_group()
+        {
+            Document text;
+            UndoHistory history;
+            size_t cursor = 0;
+            type(history, text, cursor, L"ab");
+            history.close_group();
+            type(history, text, cursor, L"cd");
+
+            history.begin_group();
+            history.erase(text, 0, 1, cursor);
+            history.insert(text, 3, L"!", 1, cursor);
+            history.end_group();
+            CHECK(test, text_of(text) == L"bcd!");
+
+            CHECK(test, history.undo(text, cursor));
+            CHECK(test, text_of(text) == L"abcd");
+            CHECK(test, history.undo(text, cursor));
+            CHECK(test, text_of(text) == L"ab");
+            CHECK(test, history.undo(text, cursor));
+            CHECK(test, text_of(text) == L"");
+        }
+
+        // a new edit drops what could be redone
+        {
+            Document text;
+            UndoHistory history;
+            size_t cursor = 0;
+            type(history, text, cursor, L"ab");
+            history.undo(text, cursor);
+            CHECK(test, history.can_redo());
+            type(history, text, cursor, L"c");
+            CHECK(test, !history.can_redo());
+        }
+
+        // beyond the memory limit the oldest groups are dropped, but never
+        // the last one
+        {
+            Document text;
+            UndoHistory history;
+            size_t cursor = 0;
+            for (int i = 0; i < 100; ++i) {
+                type(history, text, cursor, L"word");
+                history.close_group();
+            }
+            auto used = history.get_memory_used();
+            history.set_memory_limit(used / 10);
+            CHECK(test, history.get_memory_used() <= used / 10);
+
+            size_t undo_count = 0;
+            while (history.undo(text, cursor))
+                ++undo_count;
+            CHECK(test, undo_count > 0 && undo_count <= 10);
+            CHECK(test, text.size() == (100 - undo_count) * 4);
+
+            history.clear();
+            history.set_memory_limit(0);
+            type(history, text, cursor, L"kept");
+            CHECK(test, history.can_undo());
+        }
+    }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Test.hpp"
+#include "Utf8.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+class Utf8Test {
+    static std::wstring decode(const std::string& bytes) {
+        std::wstring chars(bytes.size(), L'\0');
+        chars.resize(Utf8::decode(bytes.data(), bytes.size(), &chars[0]));
+        return chars;
+    }
+
+    // decoding and counting agree
+    static void check_decode(Test& test, const std::string& bytes, const std::wstring& expected) {
+        CHECK(test, decode(bytes) == expected);
+        CHECK(test, Utf8::decode(bytes.data(), bytes.size(), nullptr) == expected.size());
+    }
+
+    // encode in pieces of the given size and decode again
+    static std::string encode(const std::wstring& chars, size_t piece_size, bool crlf) {
+        auto sink = [](std::string& bytes) {
+            return [&bytes](const char* first, size_t count) {
+                bytes.append(first, count);
+            };
+        };
+        std::string bytes;
+        Utf8Writer<decltype(sink(bytes))> writer(sink(bytes), crlf);
+        for (size_t i = 0; i < chars.size(); i += piece_size)
+            writer.write(chars.data() + i, std::min(piece_size, chars.size() - i));
+        writer.flush();
+        return bytes;
+    }
+
+public:
+    static void run(Test& test) {
+        // a non-ascii sequence and a "\r\n" at every place around the
+        // 16 and 32 byte runs of the vectorized ascii copy
+        for (size_t prefix = 0; prefix < 70; ++prefix) {
+            std::string ascii(prefix, 'a');
+            std::wstring wide(prefix, L'a');
+            check_decode(test, ascii, wide);
+            check_decode(test, ascii + "\xc3\xa9" + ascii, wide + L"\x00e9" + wide);
+            check_decode(test, ascii + "\xe4\xb8\xad" + ascii, wide + L"\x4e2d" + wide);
+            check_decode(test, ascii + "\r\n" + ascii, wide + L"\n" + wide);
+            check_decode(test, ascii + "\r" + ascii, wide + L"\r" + wide);
+            check_decode(test, ascii + "\r\r\n", wide + L"\r\n");
+            // a sequence cut by the end
+            check_decode(test, ascii + "\xe4\xb8", wide + L"\xfffd");
+        }
+
+        // a code point above U+FFFF, as a surrogate pair with a 16-bit wchar_t
+        if (sizeof(wchar_t) == 2)
+            check_decode(test, "\xf0\x9f\x98\x80", std::wstring{ wchar_t(0xd83d), wchar_t(0xde00) });
+        else
+            check_decode(test, "\xf0\x9f\x98\x80", std::wstring(1, wchar_t(0x1f600)));
+
+        // malformed input is replaced up to the first unexpected byte
+        check_decode(test, "\xff", L"\xfffd");
+        check_decode(test, "\x80x", L"\xfffdx");
+        // overlong
+        check_decode(test, "\xc0\xaf", L"\xfffd\xfffd");
+        check_decode(test, "\xe0\x80\x80", L"\xfffd\xfffd\xfffd");
+        // a surrogate
+        check_decode(test, "\xed\xa0\x80", L"\xfffd\xfffd\xfffd");
+        // above U+10FFFF
+        check_decode(test, "\xf4\x90\x80\x80", L"\xfffd\xfffd\xfffd\xfffd");
+        // a lead byte followed by ascii
+        check_decode(test, "\xe4x\xc3", L"\xfffdx\xfffd");
+
+        // encoding and decoding give back the text, whatever the pieces
+        // it is written in, and whether the line breaks are "\r\n"
+        {
+            std::wstring text;
+            for (int i = 0; i < 3000; ++i) {
+                text += std::wstring(i % 37, L'a');
+                text += L"\n\x00e9\x4e2d\t";
+            }
+            if (sizeof(wchar_t) == 2)
+                text += std::wstring{ wchar_t(0xd83d), wchar_t(0xde00) };
+            else
+                text += wchar_t(0x1f600);
+            CHECK(test, text.size() > Utf8Writer<void(*)(const char*, size_t)>::BLOCK_SIZE);
+
+            for (size_t piece_size : { size_t(1), size_t(7), size_t(64), text.size() }) {
+                auto lf = encode(text, piece_size, false);
+                auto crlf = encode(text, piece_size, true);
+                CHECK(test, decode(lf) == text);
+                CHECK(test, decode(crlf) == text);
+                CHECK(test, crlf.size() == lf.size() + 3000);
+                CHECK(test, crlf.find("\r\n") != std::string::npos);
+                CHECK(test, lf.find('\r') == std::string::npos);
+            }
+        }
+
+        // invalid code points are written as U+FFFD
+        {
+            std::wstring text{ L'a', wchar_t(0xd800), L'b' };
+            CHECK(test, decode(encode(text, 1, false)) == L"a\xfffd" L"b");
+        }
+    }
+};
@@ -0,0 +1,21 @@
+#include "ColumnIndexTest.hpp"
+#include "DocumentTest.hpp"
+#include "UndoHistoryTest.hpp"
+#include "Utf8Test.hpp"
+#include "FileLoaderTest.hpp"
+
+#include <cstdio>
+
+int main() {
+    Test test;
+    ColumnIndexTest::run(test);
+    DocumentTest::run(test);
+    UndoHistoryTest::run(test);
+    Utf8Test::run(test);
+    FileLoaderTest::run(test);
+    if (test.get_failure_count() != 0) {
+        std::printf("%d checks failed\n", test.get_failure_count());
+        return 1;
+    }
+    std::printf("all checks passed\n");
+}